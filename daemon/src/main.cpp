@@ -0,0 +1,93 @@
+//
+//  ofxUserContentUpload daemon
+//
+//  usage: ofxUserContentUploadDaemon <storageDir> [cpuCore] [curl|h2c|sendfile]
+//
+//  curl (default) runs several jobs at once, as HTTP/2 streams where the server supports it;
+//  h2c does the same over plain http (the server must speak HTTP/2 without TLS); sendfile
+//  sends one job at a time, attachments zero-copy.
+//
+//  Drains the jobs that apps using ofxUserContentUpload in enqueue only mode
+//  ( upload.setup(storageDir, ofxUserContentUpload::getDefaultRetryPolicy(), false) )
+//  leave in storageDir. Both sides need to point to the same (absolute) storageDir.
+//  Plain C++17 on top of src/core - it doesn't link openFrameworks.
+//
+
+#include "ofxUserContentUploadCore.h"
+#include "ofxUserContentUploadSendFileTransport.h"
+#include "ofxUserContentUploadCurlTransport.h"
+#include <iostream>
+#include <csignal>
+#include <thread>
+#include <chrono>
+#include <sys/resource.h>
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+static volatile std::sig_atomic_t quitRequested = 0;
+
+static void onQuitSignal(int){
+	quitRequested = 1;
+}
+
+
+int main(int argc, char ** argv){
+
+	if(argc < 2){
+		std::cerr << "usage: " << argv[0] << " <storageDir> [cpuCore] [curl|h2c|sendfile]" << std::endl;
+		return 1;
+	}
+	string storageDir = argv[1];
+
+	//stay out of the way of whatever else is running on the box
+	setpriority(PRIO_PROCESS, 0, 10);
+
+	#ifdef __linux__
+	if(argc > 2 && atoi(argv[2]) >= 0){ //pin to a core - threads created from now on (the upload thread) inherit it
+		cpu_set_t cpus;
+		CPU_ZERO(&cpus);
+		CPU_SET(atoi(argv[2]), &cpus);
+		if(sched_setaffinity(0, sizeof(cpus), &cpus) != 0){
+			std::cerr << "can't pin to cpu core " << argv[2] << std::endl;
+		}
+	}
+	#endif
+
+	signal(SIGTERM, onQuitSignal);
+	signal(SIGINT, onQuitSignal);
+
+	ofxUserContentUploadCore upload;
+	string transport = argc > 3 ? argv[3] : "curl";
+	if(transport == "sendfile"){
+		upload.setTransport(make_shared<ofxUserContentUploadSendFileTransport>());
+	}else if(transport == "h2c"){
+		upload.setTransport(make_shared<ofxUserContentUploadCurlTransport>(ofxUserContentUploadCurlTransport::HTTP_2_PRIOR_KNOWLEDGE));
+	}else{
+		upload.setTransport(make_shared<ofxUserContentUploadCurlTransport>());
+	}
+	upload.setTimeOut(20);
+	upload.setAdaptiveTimeOuts(true, 5, 600); //size time outs to each host's measured speed
+	upload.getExecuteJobsRate() = 1;
+	upload.getFailJobSkipRetryFactor() = 20;
+	upload.setMaxNumberRetries(50);
+
+	upload.onJobExecuted = [](const ofxUserContentUploadCore::JobExecutionResult & r){ //called from the upload thread
+		if(r.ok){
+			ofxUserContentUploadLog(ofxUserContentUploadLog::LEVEL_NOTICE, "daemon") << "job '" << r.jobID << "' done in " << r.duration << "s (time out " << r.timeOut << "s): " << r.serverResponse;
+		}else{
+			ofxUserContentUploadLog(ofxUserContentUploadLog::LEVEL_ERROR, "daemon") << "job '" << r.jobID << "' failed (" << r.outcome << "): " << r.serverStatusCode << " " << r.errorDescription;
+		}
+	};
+
+	upload.setup(storageDir);
+	ofxUserContentUploadLog(ofxUserContentUploadLog::LEVEL_NOTICE, "daemon") << "draining jobs from '" << storageDir << "'";
+
+	while(!quitRequested){
+		std::this_thread::sleep_for(std::chrono::milliseconds(200));
+	}
+
+	ofxUserContentUploadLog(ofxUserContentUploadLog::LEVEL_NOTICE, "daemon") << "quitting...";
+	upload.stop(); //cancels the jobs in flight, they are sent on the next run
+	return 0;
+}
@@ -0,0 +1,100 @@
+//
+//  Simulation.cpp
+//  example-simulator
+//
+
+#include "Simulation.h"
+#include <algorithm>
+
+
+VirtualClock::VirtualClock(double startTime){
+	now = startTime;
+}
+
+
+double VirtualClock::getUnixTime(){
+	return now;
+}
+
+
+void VirtualClock::sleepMillis(int ms){
+	now = now + ms / 1000.0;
+	if(onAdvance){
+		onAdvance(now);
+	}
+}
+
+
+SimulatedTransport::SimulatedTransport(shared_ptr<VirtualClock> clock, unsigned int seed){
+	this->clock = clock;
+	startTime = clock->getUnixTime();
+	rng.seed(seed);
+}
+
+
+float SimulatedTransport::errorRateAt(double t){
+	if(errorRate.empty()) return 0;
+	if(t <= errorRate.front().time) return errorRate.front().rate;
+	for(size_t i = 1; i < errorRate.size(); i++){
+		if(t < errorRate[i].time){
+			const ErrorRatePoint & a = errorRate[i - 1];
+			const ErrorRatePoint & b = errorRate[i];
+			return a.rate + (b.rate - a.rate) * (t - a.time) / (b.time - a.time);
+		}
+	}
+	return errorRate.back().rate;
+}
+
+
+ofxUserContentUploadCore::TransportResponse SimulatedTransport::submitJob(const ofxUserContentUploadCore::Job & job, float connectTimeOut, float timeOut){
+	ofxUserContentUploadCore::TransportResponse r = simulate(job, timeOut);
+	clock->sleepMillis(r.totalTime * 1000);
+	return r;
+}
+
+
+void SimulatedTransport::submitJobs(vector<ofxUserContentUploadCore::JobSubmission> & jobs){
+	float longest = 0; //they all run at once, so the batch takes as long as its slowest job
+	for(auto & s : jobs){
+		s.response = simulate(*s.job, s.timeOut);
+		longest = std::max(longest, s.response.totalTime);
+	}
+	clock->sleepMillis(longest * 1000);
+}
+
+
+ofxUserContentUploadCore::TransportResponse SimulatedTransport::simulate(const ofxUserContentUploadCore::Job & job, float timeOut){
+
+	double t = clock->getUnixTime() - startTime;
+	auto it = job.formFields.find("simBytes");
+	float bytes = it != job.formFields.end() ? std::stof(it->second) : 0;
+
+	bool inOutage = false;
+	for(auto & o : outages){
+		if(t >= o.start && t < o.end){
+			inOutage = true;
+			break;
+		}
+	}
+
+	ofxUserContentUploadCore::TransportResponse r;
+	r.url = job.host;
+	float duration = rtt + bytes / bandwidth;
+
+	if(inOutage || duration > timeOut){
+		r.status = -1;
+		r.reasonForStatus = inOutage ? "Simulated outage" : "Simulated timeout";
+		r.totalTime = timeOut;
+		return r;
+	}
+
+	r.totalTime = duration;
+	if(std::uniform_real_distribution<float>(0, 1)(rng) < errorRateAt(t)){
+		r.status = 500;
+		r.reasonForStatus = "Simulated server error";
+	}else{
+		r.status = 200;
+		r.responseBody = "{}";
+	}
+	return r;
+}
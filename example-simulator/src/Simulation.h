@@ -0,0 +1,72 @@
+//
+//  Simulation.h
+//  example-simulator
+//
+//  Virtual clock & fake transport to replay workloads through ofxUserContentUpload's
+//  real scheduling & retry logic in virtual time.
+//
+
+#pragma once
+
+#include "ofxUserContentUploadCore.h"
+#include <atomic>
+#include <random>
+
+//sleeping just moves time forward. onAdvance is called from the sleeping thread (the upload
+//thread, both from its scheduler loop and from SimulatedTransport), so the workload can be
+//injected in virtual time without racing the scheduler.
+class VirtualClock : public ofxUserContentUploadCore::Clock{
+
+public:
+
+	VirtualClock(double startTime);
+
+	double getUnixTime();
+	void sleepMillis(int ms);
+	bool isVirtual(){ return true; }
+
+	std::function<void(double now)> onAdvance;
+
+protected:
+
+	std::atomic<double> now;
+};
+
+
+//pretends to upload jobs; each job carries its payload size in the "simBytes" form field.
+//Runs up to maxConcurrentJobs at once, like the curl transport does over HTTP/2.
+class SimulatedTransport : public ofxUserContentUploadCore::Transport{
+
+public:
+
+	struct Outage{
+		double start; //seconds since the simulation started
+		double end;
+	};
+
+	struct ErrorRatePoint{ //piecewise linear curve of the probability of a server error
+		double time; //seconds since the simulation started
+		float rate; //[0..1]
+	};
+
+	SimulatedTransport(shared_ptr<VirtualClock> clock, unsigned int seed);
+
+	ofxUserContentUploadCore::TransportResponse submitJob(const ofxUserContentUploadCore::Job & job, float connectTimeOut, float timeOut);
+	int getMaxConcurrentJobs(){ return maxConcurrentJobs; }
+	void submitJobs(vector<ofxUserContentUploadCore::JobSubmission> & jobs);
+
+	vector<Outage> outages;
+	vector<ErrorRatePoint> errorRate;
+	float rtt = 0.08; //seconds
+	float bandwidth = 2 * 1024 * 1024; //bytes per second, per job
+	int maxConcurrentJobs = 8;
+
+protected:
+
+	float errorRateAt(double t);
+	ofxUserContentUploadCore::TransportResponse simulate(const ofxUserContentUploadCore::Job & job, float timeOut); //doesn't advance the clock
+
+	shared_ptr<VirtualClock> clock;
+	double startTime;
+	std::mt19937 rng;
+};
@@ -0,0 +1,308 @@
+//
+//  ofxUserContentUpload workload simulator
+//
+//  usage: ofxUserContentUploadSimulator [numJobs | workload.csv] [settings.cfg ...] [key=value ...]
+//
+//  Replays a workload through ofxUserContentUpload's scheduler & retry logic in virtual time,
+//  and reports drain time, wasted attempts, dropped jobs and latencies for a given policy.
+//  Pass a csv with one "arrivalSeconds,payloadBytes" line per job to replay a recorded one,
+//  or a number of synthetic jobs. Jobs are queued in memory and the clock never really sleeps,
+//  so a million jobs take seconds.
+//
+//  The policy, the simulated server (outages, error rate curve) and the synthetic workload come
+//  from settings files ("key = value" lines, see policy.cfg for all of them and their defaults)
+//  and key=value arguments, applied in order - ie
+//  ofxUserContentUploadSimulator 100000 policy.cfg maxJobRetries=10 "outage=none"
+//
+
+#include "ofxUserContentUploadCore.h"
+#include "ofxUserContentUploadMemoryJobStore.h"
+#include "Simulation.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+const string usage = "usage: ofxUserContentUploadSimulator [numJobs | workload.csv] [settings.cfg ...] [key=value ...]";
+
+struct Settings{
+	//synthetic workload
+	int numSyntheticJobs = 1000000;
+	float jobsPerSecond = 2;
+	float largeJobRatio = 0.002; //0.2% of the jobs are videos
+	unsigned int seed = 1234;
+
+	//upload policy - same as the daemon's
+	float executeJobsRate = 1;
+	int failJobSkipRetryFactor = 20;
+	int maxJobRetries = 50;
+	float timeOut = 20;
+	ofxUserContentUploadCore::FailedJobPolicy retryPolicy = ofxUserContentUploadCore::getDefaultRetryPolicy();
+
+	//simulated server
+	int maxConcurrentJobs = 8;
+	vector<SimulatedTransport::Outage> outages = {{3600, 3600 + 1800}, {6 * 3600, 8 * 3600}}; //30 min outage after one hour...
+	vector<SimulatedTransport::ErrorRatePoint> errorRate = {{0, 0.01}, {4 * 3600, 0.3}, {5 * 3600, 0.01}}; //server degrades for an hour
+	bool outagesSet = false; //the first outage / errorRate setting replaces the defaults, the next ones add to it
+	bool errorRateSet = false;
+};
+
+static string trim(const string & s){
+	size_t start = s.find_first_not_of(" \t\r");
+	if(start == string::npos) return "";
+	return s.substr(start, s.find_last_not_of(" \t\r") - start + 1);
+}
+
+//false (and why in error) if the key is unknown or the value doesn't make sense for it
+static bool applySetting(Settings & s, const string & key, const string & value, string & error){
+
+	std::istringstream in(value);
+	bool ok;
+	if(key == "executeJobsRate"){
+		ok = (in >> s.executeJobsRate) && s.executeJobsRate > 0;
+	}else if(key == "failJobSkipRetryFactor"){
+		ok = (in >> s.failJobSkipRetryFactor) && s.failJobSkipRetryFactor > 0;
+	}else if(key == "maxJobRetries"){
+		ok = (in >> s.maxJobRetries) && s.maxJobRetries >= 0;
+	}else if(key == "timeOut"){
+		ok = (in >> s.timeOut) && s.timeOut > 0;
+	}else if(key.compare(0, 6, "retry.") == 0){ //retry.503 = true - FailedJobPolicy entry
+		int status = atoi(key.c_str() + 6);
+		string retry;
+		ok = status > 0 && (in >> retry) && (retry == "true" || retry == "false");
+		if(ok) s.retryPolicy[status] = retry == "true";
+	}else if(key == "maxConcurrentJobs"){
+		ok = (in >> s.maxConcurrentJobs) && s.maxConcurrentJobs > 0;
+	}else if(key == "outage"){ //startSeconds endSeconds, or none
+		if(!s.outagesSet) s.outages.clear();
+		s.outagesSet = true;
+		SimulatedTransport::Outage o;
+		ok = value == "none" || ((in >> o.start >> o.end) && o.end > o.start);
+		if(ok && value != "none") s.outages.push_back(o);
+	}else if(key == "errorRate"){ //seconds rate, or none - points of a piecewise linear curve
+		if(!s.errorRateSet) s.errorRate.clear();
+		s.errorRateSet = true;
+		SimulatedTransport::ErrorRatePoint p;
+		ok = value == "none" || ((in >> p.time >> p.rate) && p.rate >= 0 && p.rate <= 1);
+		if(ok && value != "none") s.errorRate.push_back(p);
+	}else if(key == "jobsPerSecond"){
+		ok = (in >> s.jobsPerSecond) && s.jobsPerSecond > 0;
+	}else if(key == "largeJobRatio"){
+		ok = (in >> s.largeJobRatio) && s.largeJobRatio >= 0 && s.largeJobRatio <= 1;
+	}else if(key == "seed"){
+		ok = bool(in >> s.seed);
+	}else{
+		error = "unknown setting '" + key + "'";
+		return false;
+	}
+	if(ok && value != "none"){ //nothing after the value(s)
+		in >> std::ws;
+		ok = in.eof();
+	}
+	if(!ok) error = "bad value for " + key + ": '" + value + "'";
+	return ok;
+}
+
+static bool loadSettings(Settings & s, const string & path, string & error){
+	std::ifstream file(path);
+	if(!file){
+		error = "can't open settings file '" + path + "'";
+		return false;
+	}
+	string line;
+	for(int lineNum = 1; std::getline(file, line); lineNum++){
+		line = trim(line.substr(0, line.find('#')));
+		if(line.empty()) continue;
+		size_t eq = line.find('=');
+		if(eq == string::npos || !applySetting(s, trim(line.substr(0, eq)), trim(line.substr(eq + 1)), error)){
+			if(eq == string::npos) error = "expected key = value";
+			error = path + ":" + std::to_string(lineNum) + ": " + error;
+			return false;
+		}
+	}
+	return true;
+}
+
+struct SimJob{
+	double arrival; //seconds since the simulation started
+	float bytes;
+};
+
+//stats - only touched from the upload thread until it's done
+struct Stats{
+	int numAttempts = 0;
+	int numFailedAttempts = 0;
+	int numSucceeded = 0;
+	int numDropped = 0;
+	double lastFinished = 0;
+	vector<double> latencies;
+	std::atomic<bool> done{false};
+};
+
+
+static bool loadWorkload(const string & csvPath, vector<SimJob> & jobs, int & numSkippedLines){
+	std::ifstream csv(csvPath);
+	if(!csv) return false;
+	string line;
+	numSkippedLines = 0;
+	while(std::getline(csv, line)){
+		double arrival;
+		float bytes;
+		char comma;
+		std::istringstream cols(line);
+		if(cols >> arrival >> comma >> bytes && comma == ','){
+			jobs.push_back({arrival, bytes});
+		}else if(trim(line).size()){ //ie a header
+			numSkippedLines++;
+		}
+	}
+	std::stable_sort(jobs.begin(), jobs.end(), [](const SimJob & a, const SimJob & b){ return a.arrival < b.arrival; });
+	return true;
+}
+
+
+static void makeWorkload(const Settings & settings, vector<SimJob> & jobs){
+	std::mt19937 rng(settings.seed);
+	std::exponential_distribution<double> interArrival(settings.jobsPerSecond);
+	std::uniform_real_distribution<float> uniform(0, 1);
+	double t = 0;
+	for(int i = 0; i < settings.numSyntheticJobs; i++){
+		t += interArrival(rng);
+		bool large = uniform(rng) < settings.largeJobRatio;
+		float bytes = large ? (5 + 45 * uniform(rng)) * 1024 * 1024 : (2 + 498 * uniform(rng)) * 1024;
+		jobs.push_back({t, bytes});
+	}
+}
+
+
+static double percentile(const vector<double> & sorted, float p){
+	if(sorted.empty()) return 0;
+	return sorted[std::min(sorted.size() - 1, (size_t)(p * sorted.size()))];
+}
+
+
+int main(int argc, char ** argv){
+
+	auto wallStart = std::chrono::steady_clock::now();
+	ofxUserContentUploadLog::setLevel(ofxUserContentUploadLog::LEVEL_SILENT); //thousands of simulated failures would drown the report
+
+	Settings settings;
+	string workloadPath;
+	for(int i = 1; i < argc; i++){
+		string arg = argv[i];
+		string error;
+		size_t eq = arg.find('=');
+		bool ok = true;
+		if(eq != string::npos){
+			ok = applySetting(settings, arg.substr(0, eq), arg.substr(eq + 1), error);
+		}else if(i == 1 && arg.find_first_not_of("0123456789") == string::npos){
+			settings.numSyntheticJobs = std::max(atoi(arg.c_str()), 1);
+		}else if(i == 1){
+			workloadPath = arg;
+		}else{
+			ok = loadSettings(settings, arg, error);
+		}
+		if(!ok){
+			std::cerr << error << "\n" << usage << std::endl;
+			return 1;
+		}
+	}
+	std::sort(settings.errorRate.begin(), settings.errorRate.end(), [](const SimulatedTransport::ErrorRatePoint & a, const SimulatedTransport::ErrorRatePoint & b){ return a.time < b.time; });
+
+	vector<SimJob> jobs;
+	if(workloadPath.size()){
+		int numSkippedLines;
+		if(!loadWorkload(workloadPath, jobs, numSkippedLines)){
+			std::cerr << "can't open workload '" << workloadPath << "'\n" << usage << std::endl;
+			return 1;
+		}
+		std::cout << "loaded " << jobs.size() << " jobs from " << workloadPath;
+		if(numSkippedLines) std::cout << " (skipped " << numSkippedLines << " lines that aren't arrivalSeconds,payloadBytes)";
+		std::cout << std::endl;
+	}else{
+		makeWorkload(settings, jobs);
+	}
+	if(jobs.empty()){
+		std::cerr << "no jobs to simulate!" << std::endl;
+		return 1;
+	}
+
+	double startTime = 1500000000; //arbitrary fixed start, so runs are repeatable
+	auto clock = make_shared<VirtualClock>(startTime);
+	auto transport = make_shared<SimulatedTransport>(clock, settings.seed);
+	transport->outages = settings.outages;
+	transport->errorRate = settings.errorRate;
+	transport->maxConcurrentJobs = settings.maxConcurrentJobs;
+
+	ofxUserContentUploadCore upload;
+	Stats stats;
+	size_t nextArrival = 0;
+
+	//both called from the upload thread
+	clock->onAdvance = [&](double now){
+		while(nextArrival < jobs.size() && startTime + jobs[nextArrival].arrival <= now){
+			ofxUserContentUploadCore::Job job;
+			job.createJob("http://simulated/submit", 80, std::to_string(nextArrival));
+			job.addStringField("simBytes", std::to_string((int64_t)jobs[nextArrival].bytes));
+			upload.addJob(job);
+			nextArrival++;
+		}
+	};
+
+	upload.onJobExecuted = [&](const ofxUserContentUploadCore::JobExecutionResult & r){
+		stats.numAttempts++;
+		if(!r.ok) stats.numFailedAttempts++;
+		switch(r.outcome){
+			case ofxUserContentUploadCore::JOB_SUCCEEDED:
+				stats.numSucceeded++;
+				stats.latencies.push_back(r.time - (startTime + jobs[std::stoul(r.jobID)].arrival));
+				break;
+			case ofxUserContentUploadCore::JOB_FAILED_DROPPED:
+				stats.numDropped++;
+				break;
+			default: break;
+		}
+		stats.lastFinished = std::max(stats.lastFinished, r.time);
+		if(stats.numSucceeded + stats.numDropped == (int)jobs.size()){
+			stats.done = true;
+		}
+	};
+
+	upload.setClock(clock);
+	upload.setTransport(transport);
+	upload.setJobStore(make_shared<ofxUserContentUploadMemoryJobStore>());
+	upload.setRandomSeed(settings.seed);
+	upload.setTimeOut(settings.timeOut);
+	upload.getExecuteJobsRate() = settings.executeJobsRate;
+	upload.getFailJobSkipRetryFactor() = settings.failJobSkipRetryFactor;
+	upload.setMaxNumberRetries(settings.maxJobRetries);
+
+	std::cout << "simulating " << jobs.size() << " jobs - executeJobsRate " << settings.executeJobsRate
+	<< ", failJobSkipRetryFactor " << settings.failJobSkipRetryFactor << ", maxJobRetries " << settings.maxJobRetries
+	<< ", timeOut " << settings.timeOut << ", " << settings.outages.size() << " outages, "
+	<< settings.errorRate.size() << " error rate points..." << std::endl;
+	upload.setup("simulation", settings.retryPolicy);
+
+	while(!stats.done){
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+	upload.stop();
+
+	std::sort(stats.latencies.begin(), stats.latencies.end());
+	std::chrono::duration<double> wallTime = std::chrono::steady_clock::now() - wallStart;
+
+	std::cout << "simulation done in " << wallTime.count() << " sec of wall time\n"
+	<< "  Jobs: " << jobs.size() << "\n"
+	<< "  Drain Time: " << (stats.lastFinished - startTime) / 3600.0 << " hours\n"
+	<< "  Attempts: " << stats.numAttempts << "\n"
+	<< "  Wasted Attempts: " << stats.numFailedAttempts << "\n"
+	<< "  Succeeded: " << stats.numSucceeded << "\n"
+	<< "  Dropped: " << stats.numDropped << "\n"
+	<< "  Latency p50: " << percentile(stats.latencies, 0.5) << " sec\n"
+	<< "  Latency p90: " << percentile(stats.latencies, 0.9) << " sec\n"
+	<< "  Latency p99: " << percentile(stats.latencies, 0.99) << " sec\n"
+	<< "  Latency max: " << (stats.latencies.empty() ? 0 : stats.latencies.back()) << " sec" << std::endl;
+	return 0;
+}
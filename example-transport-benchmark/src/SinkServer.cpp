@@ -0,0 +1,202 @@
+//
+//  SinkServer.cpp
+//  example-transport-benchmark
+//
+
+#include "SinkServer.h"
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <sys/time.h>
+
+
+SinkServer::~SinkServer(){
+	stop();
+}
+
+
+bool SinkServer::start(){
+
+	listenSocket = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if(listenSocket < 0) return false;
+	int yes = 1;
+	setsockopt(listenSocket, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+
+	struct sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = 0;
+	socklen_t len = sizeof(addr);
+	if(bind(listenSocket, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(listenSocket, 16) != 0 ||
+	   getsockname(listenSocket, (struct sockaddr*)&addr, &len) != 0){
+		close(listenSocket);
+		listenSocket = -1;
+		return false;
+	}
+	port = ntohs(addr.sin_port);
+	running = true;
+	thread = std::thread(&SinkServer::run, this);
+	return true;
+}
+
+
+void SinkServer::stop(){
+	running = false;
+	if(thread.joinable()) thread.join();
+	for(auto & t : connections){
+		if(t.joinable()) t.join();
+	}
+	connections.clear();
+	if(listenSocket >= 0) close(listenSocket);
+	listenSocket = -1;
+}
+
+
+void SinkServer::run(){
+	while(running){
+		struct pollfd p = {listenSocket, POLLIN, 0};
+		if(poll(&p, 1, 100) <= 0) continue;
+		int client = accept4(listenSocket, nullptr, nullptr, SOCK_CLOEXEC);
+		if(client >= 0){
+			connections.emplace_back(&SinkServer::serve, this, client);
+		}
+	}
+}
+
+
+void SinkServer::serve(int client){
+
+	static const std::string preface = "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n";
+	struct timeval t = {0, 100000}; //so stop() doesn't wait on idle connections
+	setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &t, sizeof(t));
+
+	std::string received;
+	char buffer[4096];
+	while(running && received.compare(0, preface.size(), preface, 0, received.size()) == 0 && received.size() < preface.size()){
+		ssize_t n = recv(client, buffer, sizeof(buffer), 0);
+		if(n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) break;
+		if(n > 0) received.append(buffer, n);
+	}
+	if(received.size() >= preface.size() && received.compare(0, preface.size(), preface) == 0){
+		received.erase(0, preface.size());
+		serveHttp2(client, received);
+	}else if(received.size()){
+		serveHttp1(client, received);
+	}
+	close(client);
+}
+
+
+void SinkServer::serveHttp1(int client, std::string & head){
+
+	std::vector<char> buffer(256 * 1024);
+	size_t headerEnd = head.find("\r\n\r\n");
+	while(headerEnd == std::string::npos){
+		ssize_t n = recv(client, buffer.data(), buffer.size(), 0);
+		if(n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK) && running) continue;
+		if(n <= 0) return;
+		head.append(buffer.data(), n);
+		headerEnd = head.find("\r\n\r\n");
+	}
+
+	std::string headers = head.substr(0, headerEnd);
+	std::transform(headers.begin(), headers.end(), headers.begin(), [](unsigned char c){ return std::tolower(c); });
+	size_t cl = headers.find("\r\ncontent-length:");
+	bool chunked = headers.find("\r\ntransfer-encoding: chunked") != std::string::npos;
+	long long left = cl != std::string::npos ? strtoll(headers.c_str() + cl + 17, nullptr, 10) : 0;
+	left -= head.size() - headerEnd - 4;
+
+	std::string tail = head.substr(headerEnd + 4); //only the last few bytes matter for chunked bodies
+	while(chunked ? tail.find("\r\n0\r\n\r\n") == std::string::npos : left > 0){
+		ssize_t n = recv(client, buffer.data(), buffer.size(), 0);
+		if(n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK) && running) continue;
+		if(n <= 0) return;
+		left -= n;
+		if(chunked){
+			tail = tail.substr(tail.size() > 8 ? tail.size() - 8 : 0) + std::string(buffer.data() + (n > 8 ? n - 8 : 0), n > 8 ? 8 : n);
+		}
+	}
+
+	const char response[] = "HTTP/1.1 200 OK\r\nContent-Length: 2\r\nConnection: close\r\n\r\n{}";
+	send(client, response, sizeof(response) - 1, MSG_NOSIGNAL);
+}
+
+
+//just enough HTTP/2 to take uploads: request headers are never decoded (no HPACK), each stream
+//gets its 200 once its request is complete, and the flow control windows are kept wide open.
+void SinkServer::serveHttp2(int client, std::string & received){
+
+	enum{ DATA = 0, HEADERS = 1, SETTINGS = 4, PING = 6, GOAWAY = 7, WINDOW_UPDATE = 8, CONTINUATION = 9 };
+	enum{ END_STREAM = 0x1, ACK = 0x1, END_HEADERS = 0x4 };
+	const uint32_t maxWindow = 0x7fffffff;
+
+	auto u32 = [](uint32_t v){ return std::string{(char)(v >> 24), (char)(v >> 16), (char)(v >> 8), (char)v}; };
+	auto sendFrame = [&](uint8_t type, uint8_t flags, uint32_t stream, const std::string & payload){
+		std::string f = u32((uint32_t)payload.size() << 8 | type) + (char)flags + u32(stream & maxWindow) + payload;
+		return send(client, f.data(), f.size(), MSG_NOSIGNAL) == (ssize_t)f.size();
+	};
+	auto respond = [&](uint32_t stream){
+		return sendFrame(HEADERS, END_HEADERS, stream, "\x88") && //":status: 200" from the HPACK static table
+			sendFrame(DATA, END_STREAM, stream, "{}");
+	};
+
+	//SETTINGS_INITIAL_WINDOW_SIZE (4) at its max, and the connection window too
+	if(!sendFrame(SETTINGS, 0, 0, std::string("\0\x04", 2) + u32(maxWindow)) ||
+	   !sendFrame(WINDOW_UPDATE, 0, 0, u32(maxWindow - 65535))){
+		return;
+	}
+
+	std::vector<char> buffer(256 * 1024);
+	uint32_t unacked = 0; //DATA bytes read since we last widened the connection window
+	uint32_t headersEndStream = 0; //stream whose request ended with a HEADERS frame still waiting for CONTINUATION
+	size_t pos = 0;
+	while(running){
+		while(received.size() - pos >= 9){
+			const unsigned char * h = (const unsigned char *)received.data() + pos;
+			size_t len = h[0] << 16 | h[1] << 8 | h[2];
+			if(received.size() - pos < 9 + len) break;
+			uint8_t type = h[3], flags = h[4];
+			uint32_t stream = (h[5] & 0x7f) << 24 | h[6] << 16 | h[7] << 8 | h[8];
+			std::string payload = type == DATA ? std::string() : received.substr(pos + 9, len);
+			pos += 9 + len;
+
+			bool ok = true;
+			if(type == DATA){
+				unacked += len;
+				if(unacked >= (1 << 24)){
+					ok = sendFrame(WINDOW_UPDATE, 0, 0, u32(unacked));
+					unacked = 0;
+				}
+				if(ok && (flags & END_STREAM)) ok = respond(stream);
+			}else if(type == HEADERS || type == CONTINUATION){
+				if(type == HEADERS && (flags & END_STREAM)) headersEndStream = stream;
+				if((flags & END_HEADERS) && headersEndStream == stream){
+					headersEndStream = 0;
+					ok = respond(stream);
+				}
+			}else if(type == SETTINGS && !(flags & ACK)){
+				ok = sendFrame(SETTINGS, ACK, 0, "");
+			}else if(type == PING && !(flags & ACK)){
+				ok = sendFrame(PING, ACK, 0, payload);
+			}else if(type == GOAWAY){
+				return;
+			}
+			if(!ok) return;
+		}
+		received.erase(0, pos);
+		pos = 0;
+
+		ssize_t n = recv(client, buffer.data(), buffer.size(), 0);
+		if(n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) continue;
+		if(n <= 0) return;
+		received.append(buffer.data(), n);
+	}
+}
@@ -0,0 +1,40 @@
+//
+//  SinkServer.h
+//  example-transport-benchmark
+//
+//  Minimal local http server that reads & discards whatever is posted to it and answers 200,
+//  so the benchmark measures the client side only. Speaks HTTP/1.1, and enough HTTP/2 for
+//  clients that start with its preface (h2c with prior knowledge) to upload over concurrent
+//  streams. Each connection is served on its own thread.
+//
+
+#pragma once
+
+#include <string>
+#include <thread>
+#include <atomic>
+#include <vector>
+
+class SinkServer{
+
+public:
+
+	~SinkServer();
+
+	bool start(); //listens on 127.0.0.1, on a free port
+	void stop();
+	int getPort(){ return port; }
+
+protected:
+
+	void run();
+	void serve(int client);
+	void serveHttp1(int client, std::string & received);
+	void serveHttp2(int client, std::string & received);
+
+	int listenSocket = -1;
+	int port = 0;
+	std::thread thread;
+	std::vector<std::thread> connections;
+	std::atomic<bool> running{false};
+};
@@ -0,0 +1,137 @@
+//
+//  ThrottledRelay.cpp
+//  example-transport-benchmark
+//
+
+#include "ThrottledRelay.h"
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <unistd.h>
+#include <string.h>
+#include <algorithm>
+
+
+ThrottledRelay::~ThrottledRelay(){
+	stop();
+}
+
+
+bool ThrottledRelay::start(int targetPort, double bytesPerSecond){
+
+	this->targetPort = targetPort;
+	this->bytesPerSecond = bytesPerSecond;
+	listenSocket = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if(listenSocket < 0) return false;
+	int yes = 1;
+	setsockopt(listenSocket, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+
+	struct sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = 0;
+	socklen_t len = sizeof(addr);
+	if(bind(listenSocket, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(listenSocket, 64) != 0 ||
+	   getsockname(listenSocket, (struct sockaddr*)&addr, &len) != 0){
+		close(listenSocket);
+		listenSocket = -1;
+		return false;
+	}
+	port = ntohs(addr.sin_port);
+	linkStart = std::chrono::steady_clock::now();
+	running = true;
+	thread = std::thread(&ThrottledRelay::run, this);
+	return true;
+}
+
+
+void ThrottledRelay::stop(){
+	running = false;
+	if(thread.joinable()) thread.join();
+	for(auto & t : connections){
+		if(t.joinable()) t.join();
+	}
+	connections.clear();
+	if(listenSocket >= 0) close(listenSocket);
+	listenSocket = -1;
+}
+
+
+void ThrottledRelay::run(){
+	while(running){
+		struct pollfd p = {listenSocket, POLLIN, 0};
+		if(poll(&p, 1, 100) <= 0) continue;
+		int client = accept4(listenSocket, nullptr, nullptr, SOCK_CLOEXEC);
+		if(client >= 0){
+			connections.emplace_back(&ThrottledRelay::relay, this, client);
+		}
+	}
+}
+
+
+size_t ThrottledRelay::takeUploadBytes(size_t wanted){
+	while(running){
+		{
+			std::lock_guard<std::mutex> lock(linkMutex);
+			double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - linkStart).count();
+			double room = elapsed * bytesPerSecond - linkBytes;
+			double maxBurst = bytesPerSecond * 0.01; //an idle link doesn't save up bandwidth for later
+			if(room > maxBurst){
+				linkBytes += room - maxBurst;
+				room = maxBurst;
+			}
+			if(room >= std::min((double)wanted, bytesPerSecond * 0.001)){ //a ms worth at least - no byte sized reads
+				size_t n = std::min(wanted, (size_t)room);
+				linkBytes += n;
+				return n;
+			}
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	return 0;
+}
+
+
+void ThrottledRelay::relay(int client){
+
+	int server = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	struct sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = htons(targetPort);
+	if(server < 0 || connect(server, (struct sockaddr*)&addr, sizeof(addr)) != 0){
+		if(server >= 0) close(server);
+		close(client);
+		return;
+	}
+	int yes = 1;
+	setsockopt(client, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+	setsockopt(server, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+	int small = 64 * 1024; //so the client can't park megabytes in the socket buffers, like on a real uplink
+	setsockopt(client, SOL_SOCKET, SO_RCVBUF, &small, sizeof(small));
+
+	std::vector<char> buffer(64 * 1024);
+	while(running){
+		struct pollfd p[2] = {{client, POLLIN, 0}, {server, POLLIN, 0}};
+		if(poll(p, 2, 100) <= 0) continue;
+		if(p[0].revents & (POLLIN | POLLHUP | POLLERR)){ //upload, throttled
+			size_t n = takeUploadBytes(buffer.size());
+			ssize_t r = recv(client, buffer.data(), n, 0);
+			if(r <= 0 || send(server, buffer.data(), r, MSG_NOSIGNAL) != r) break;
+			if((size_t)r < n){ //give back what we didn't use
+				std::lock_guard<std::mutex> lock(linkMutex);
+				linkBytes -= n - r;
+			}
+		}
+		if(p[1].revents & (POLLIN | POLLHUP | POLLERR)){ //responses, not throttled
+			ssize_t r = recv(server, buffer.data(), buffer.size(), 0);
+			if(r <= 0 || send(client, buffer.data(), r, MSG_NOSIGNAL) != r) break;
+		}
+	}
+	close(server);
+	close(client);
+}
@@ -0,0 +1,46 @@
+//
+//  ThrottledRelay.h
+//  example-transport-benchmark
+//
+//  Local tcp relay that forwards everything to 127.0.0.1:targetPort, with all the uploaded bytes
+//  (client to server, all connections together) limited to bytesPerSecond - a slow uplink, so a
+//  large upload takes long enough to get in the way of the small ones. Works for any protocol.
+//
+
+#pragma once
+
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <chrono>
+#include <cstdint>
+
+class ThrottledRelay{
+
+public:
+
+	~ThrottledRelay();
+
+	bool start(int targetPort, double bytesPerSecond); //listens on 127.0.0.1, on a free port
+	void stop();
+	int getPort(){ return port; }
+
+protected:
+
+	void run();
+	void relay(int client);
+	size_t takeUploadBytes(size_t wanted); //blocks until the link has room for some of them
+
+	int listenSocket = -1;
+	int port = 0;
+	int targetPort = 0;
+	double bytesPerSecond = 0;
+	std::thread thread;
+	std::vector<std::thread> connections;
+	std::atomic<bool> running{false};
+
+	std::mutex linkMutex;
+	std::chrono::steady_clock::time_point linkStart;
+	double linkBytes = 0; //uploaded since linkStart (+ the bandwidth left unused)
+};
@@ -0,0 +1,182 @@
+#include "ofApp.h"
+#include <sys/resource.h>
+
+//uploads the same large file through HttpFormTransport (ofxHttpForm, buffered),
+//ofxUserContentUploadCurlTransport (libcurl, streamed from disk) and
+//ofxUserContentUploadSendFileTransport (sendfile(), zero-copy) to a local sink server, and
+//reports the CPU each one burns per GB sent. Only the uploading thread's CPU is counted.
+//
+//Then it measures how long a mixed queue takes to drain through the upload thread: one large
+//job plus lots of tiny ones, over a throttled link (ThrottledRelay), with the curl transport
+//speaking HTTP/2 (h2c, all jobs as streams of one connection) and HTTP/1.1 (a connection per job).
+
+const int fileSizeMB = 256;
+const int numUploads = 8;
+
+const int drainSmallJobs = 200;
+const double drainLinkMBps = 40; //upload bandwidth of the throttled link
+
+static double threadCpuTime(){
+	struct rusage u;
+	getrusage(RUSAGE_THREAD, &u);
+	return u.ru_utime.tv_sec + u.ru_stime.tv_sec + (u.ru_utime.tv_usec + u.ru_stime.tv_usec) / 1000000.0;
+}
+
+
+void ofApp::setup(){
+
+	ofSetLogLevel("ofxUserContentUpload", OF_LOG_WARNING);
+
+	if(!sink.start()){
+		ofLogError("ofApp") << "can't start the sink server!";
+		ofExit(1);
+		return;
+	}
+
+	string filePath = ofToDataPath("benchmark.bin", true);
+	{
+		ofFile f(filePath, ofFile::WriteOnly, true);
+		vector<char> block(1024 * 1024);
+		for(size_t i = 0; i < block.size(); i++) block[i] = (char)ofRandom(256); //not compressible
+		for(int i = 0; i < fileSizeMB; i++) f.write(block.data(), block.size());
+	}
+	uint64_t bytes = (uint64_t)fileSizeMB * 1024 * 1024 * numUploads;
+
+	ofxUserContentUpload::Job job;
+	job.createJob("http://127.0.0.1:" + ofToString(sink.getPort()) + "/upload", sink.getPort(), "benchmark");
+	job.addStringField("description", "transport benchmark");
+	job.addFile("file", filePath, "application/octet-stream");
+
+	ofxUserContentUpload::HttpFormTransport httpForm;
+	ofxUserContentUploadCurlTransport curl(ofxUserContentUploadCurlTransport::HTTP_1_1, 1);
+	ofxUserContentUploadSendFileTransport sendFile;
+
+	run(sendFile, job, 1); //warm up the page cache
+	report("HttpFormTransport", run(httpForm, job, numUploads), bytes);
+	report("CurlTransport", run(curl, job, numUploads), bytes);
+	report("SendFileTransport", run(sendFile, job, numUploads), bytes);
+
+	report("CurlTransport HTTP/2 (h2c)", drain(make_shared<ofxUserContentUploadCurlTransport>(ofxUserContentUploadCurlTransport::HTTP_2_PRIOR_KNOWLEDGE), filePath));
+	report("CurlTransport HTTP/1.1", drain(make_shared<ofxUserContentUploadCurlTransport>(ofxUserContentUploadCurlTransport::HTTP_1_1), filePath));
+
+	ofFile::removeFile(filePath, false);
+	sink.stop();
+	ofExit();
+}
+
+
+ofApp::Result ofApp::run(ofxUserContentUpload::Transport & transport, const ofxUserContentUpload::Job & job, int numUploads){
+
+	Result r;
+	double cpuStart = threadCpuTime();
+	float start = ofGetElapsedTimef();
+	for(int i = 0; i < numUploads; i++){
+		ofxUserContentUpload::TransportResponse response = transport.submitJob(job, 10, 600);
+		if(response.status == 200){
+			r.numOk++;
+		}else{
+			ofLogError("ofApp") << "upload failed: " << response.status << " " << response.reasonForStatus;
+		}
+	}
+	r.wallTime = ofGetElapsedTimef() - start;
+	r.cpuTime = threadCpuTime() - cpuStart;
+	return r;
+}
+
+
+void ofApp::report(const string & name, const Result & r, uint64_t bytes){
+
+	double gb = bytes / (1024.0 * 1024.0 * 1024.0);
+	ofLogNotice("ofApp") << name << ": " << r.numOk << "/" << numUploads << " ok, "
+		<< ofToString(bytes / (1024.0 * 1024.0) / r.wallTime, 1) << " MB/s, "
+		<< ofToString(r.cpuTime / gb, 3) << " CPU seconds per GB";
+}
+
+
+ofApp::DrainResult ofApp::drain(shared_ptr<ofxUserContentUpload::Transport> transport, const string & largeFile){
+
+	string drainFile = ofToDataPath("drain.bin", true);
+	ofFile::copyFromTo(largeFile, drainFile, false, true); //sent jobs get their files deleted
+
+	DrainResult r;
+	ThrottledRelay relay;
+	if(!relay.start(sink.getPort(), drainLinkMBps * 1024 * 1024)){
+		ofLogError("ofApp") << "can't start the throttled relay!";
+		return r;
+	}
+
+	ofxUserContentUpload upload;
+	upload.setJobStore(make_shared<ofxUserContentUploadMemoryJobStore>());
+	upload.setTransport(transport);
+	upload.getExecuteJobsRate() = 0.1;
+	upload.setTimeOut(600);
+
+	std::mutex mutex;
+	vector<double> smallJobTimes;
+	float start = ofGetElapsedTimef();
+	float smallJobsStart = 0;
+	upload.onJobExecuted = [&](const ofxUserContentUpload::JobExecutionResult & result){ //upload thread
+		std::lock_guard<std::mutex> lock(mutex);
+		float now = ofGetElapsedTimef();
+		r.numDone++;
+		if(result.ok){
+			r.numOk++;
+		}else{
+			ofLogError("ofApp") << "job '" << result.jobID << "' failed: " << result.errorDescription;
+		}
+		if(result.jobID == "large"){
+			r.largeJobTime = now - start;
+		}else{
+			smallJobTimes.push_back(now - smallJobsStart);
+		}
+		r.drainTime = now - start;
+	};
+	upload.setup("drain");
+
+	string url = "http://127.0.0.1:" + ofToString(relay.getPort()) + "/upload";
+	ofxUserContentUpload::Job large;
+	large.createJob(url, relay.getPort(), "large");
+	large.addFile("file", drainFile, "application/octet-stream");
+	upload.addJob(large);
+
+	ofSleepMillis(500); //the tiny jobs show up while the large one is being sent
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		smallJobsStart = ofGetElapsedTimef();
+	}
+	for(int i = 0; i < drainSmallJobs; i++){
+		ofxUserContentUpload::Job small;
+		small.createJob(url, relay.getPort(), "small" + ofToString(i));
+		small.addStringField("description", "tiny job");
+		upload.addJob(small);
+	}
+
+	while(true){
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if(r.numDone >= drainSmallJobs + 1) break; //failures count too - this is a local server, they shouldn't happen
+		}
+		ofSleepMillis(10);
+	}
+	upload.stop();
+	relay.stop();
+	ofFile::removeFile(drainFile, false);
+
+	std::sort(smallJobTimes.begin(), smallJobTimes.end());
+	r.smallJobsMedian = smallJobTimes[smallJobTimes.size() / 2];
+	r.smallJobsMax = smallJobTimes.back();
+	return r;
+}
+
+
+void ofApp::report(const string & name, const DrainResult & r){
+
+	ofLogNotice("ofApp") << name << ": " << r.numOk << "/" << drainSmallJobs + 1 << " ok, drained in "
+		<< ofToString(r.drainTime, 2) << " sec (large job " << ofToString(r.largeJobTime, 2)
+		<< " sec), small jobs sent in " << ofToString(r.smallJobsMedian, 3) << " sec median, "
+		<< ofToString(r.smallJobsMax, 3) << " sec max";
+}
+
+
+void ofApp::update(){
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "ofMain.h"
+#include "ofxUserContentUpload.h"
+#include "ofxUserContentUploadSendFileTransport.h"
+#include "ofxUserContentUploadCurlTransport.h"
+#include "ofxUserContentUploadMemoryJobStore.h"
+#include "SinkServer.h"
+#include "ThrottledRelay.h"
+
+class ofApp : public ofBaseApp{
+
+public:
+	void setup();
+	void update();
+
+	struct Result{
+		int numOk = 0;
+		double wallTime = 0; //seconds
+		double cpuTime = 0; //user + sys seconds, on the uploading thread only
+	};
+
+	Result run(ofxUserContentUpload::Transport & transport, const ofxUserContentUpload::Job & job, int numUploads);
+	void report(const string & name, const Result & r, uint64_t bytes);
+
+	struct DrainResult{
+		int numOk = 0;
+		int numDone = 0;
+		double drainTime = 0; //seconds until the whole queue was sent
+		double largeJobTime = 0;
+		double smallJobsMedian = 0; //seconds from addJob() to sent
+		double smallJobsMax = 0;
+	};
+
+	DrainResult drain(shared_ptr<ofxUserContentUpload::Transport> transport, const string & largeFile);
+	void report(const string & name, const DrainResult & r);
+
+	SinkServer sink;
+};
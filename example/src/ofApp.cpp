@@ -45,6 +45,7 @@ void ofApp::keyPressed(int key){
 		job.addStringField("email_address2", "banana@uri.cat");
 		job.addStringField("language", "en");
 		job.addFile("file", "benotto.jpg");
+		job.expireAfter(60 * 60); //no point in sending it if it's more than 1h late
 		job.verbose = true;
 		upload.addJob(job);
 		counter++;
@@ -0,0 +1,809 @@
+//
+//  ofxUserContentUploadCore.cpp
+//  ofxUserContentUpload
+//
+//  Created by Oriol Ferrer Mesià on 01/02/15.
+//
+//
+
+#include "ofxUserContentUploadCore.h"
+#include <filesystem>
+#include <algorithm>
+#include <chrono>
+
+namespace fs = std::filesystem;
+
+#define LOG_NOTICE	ofxUserContentUploadLog(ofxUserContentUploadLog::LEVEL_NOTICE, "ofxUserContentUpload")
+#define LOG_WARNING	ofxUserContentUploadLog(ofxUserContentUploadLog::LEVEL_WARNING, "ofxUserContentUpload")
+#define LOG_ERROR	ofxUserContentUploadLog(ofxUserContentUploadLog::LEVEL_ERROR, "ofxUserContentUpload")
+
+
+ofxUserContentUploadCore::~ofxUserContentUploadCore(){
+	stop();
+}
+
+ofxUserContentUploadCore::ofxUserContentUploadCore(){
+
+	executeJobsRate = 1.0; //reasonable default
+	failJobSkipRetryFactor = 20;
+	timeOut = 20;
+	clock = make_shared<SystemClock>();
+	rng.seed(std::random_device()());
+	store = make_shared<ofxUserContentUploadJobStore>();
+	running = false;
+	numExecutedOkJobs = numExecutedFailedJobs = numExpiredJobs = 0;
+	numPendingWhenLastChecked = numFailedWhenLastChecked = 0;
+}
+
+
+void ofxUserContentUploadCore::setTransport(shared_ptr<Transport> t){
+	if(!t){
+		LOG_ERROR << "can't setTransport() to a null transport!";
+		return;
+	}
+	std::lock_guard<std::mutex> lock(mutex);
+	transport = t;
+}
+
+
+shared_ptr<ofxUserContentUploadCore::Transport> ofxUserContentUploadCore::getTransport(){
+	std::lock_guard<std::mutex> lock(mutex);
+	return transport;
+}
+
+
+void ofxUserContentUploadCore::setClock(shared_ptr<Clock> c){
+	if(!c){
+		LOG_ERROR << "can't setClock() to a null clock!";
+		return;
+	}
+	if(running){
+		LOG_ERROR << "can't setClock() after setup()!";
+		return;
+	}
+	clock = c;
+}
+
+
+shared_ptr<ofxUserContentUploadCore::Clock> ofxUserContentUploadCore::getClock(){
+	return clock;
+}
+
+
+void ofxUserContentUploadCore::setJobStore(shared_ptr<ofxUserContentUploadJobStore> s){
+	if(!s){
+		LOG_ERROR << "can't setJobStore() to a null store!";
+		return;
+	}
+	if(storageDir.size()){
+		LOG_ERROR << "can't setJobStore() after setup()!";
+		return;
+	}
+	store = s;
+}
+
+
+void ofxUserContentUploadCore::setRandomSeed(unsigned int seed){
+	if(running){
+		LOG_ERROR << "can't setRandomSeed() after setup()!";
+		return;
+	}
+	rng.seed(seed);
+}
+
+
+void ofxUserContentUploadCore::takeExecutedJobs(vector<JobExecutionResult> & results){
+	std::lock_guard<std::mutex> lock(mutex);
+	results.insert(results.end(), executedJobs.begin(), executedJobs.end());
+	executedJobs.clear();
+}
+
+
+ofxUserContentUploadCore::Status ofxUserContentUploadCore::getStatus(){
+	Status s;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		s.numPending = pendingApiRequests.size();
+	}
+	s.numPending += numPendingWhenLastChecked;
+	s.numFailed = numFailedWhenLastChecked;
+	s.numExecutedOk = numExecutedOkJobs;
+	s.numExecutedFailed = numExecutedFailedJobs;
+	s.numExpired = numExpiredJobs;
+	s.enqueueOnly = enqueueOnly;
+	return s;
+}
+
+
+string ofxUserContentUploadCore::resolvePath(const string & path){
+	if(path.empty() || dataPath.empty() || fs::path(path).is_absolute()) return path;
+	return (fs::path(dataPath) / path).string();
+}
+
+
+void ofxUserContentUploadCore::setup(const string &storageDir, FailedJobPolicy retryPolicy, bool runUploader){
+
+	//given a serverside http status code after executing a job
+	//should the job be deleted (true) or stored for a Retry Later (false)?
+	//if no specification, job will BE RETRIED LATER
+
+	if(running){
+		LOG_ERROR << "already setup!";
+		return;
+	}
+
+	this->retryPolicy = retryPolicy;
+	this->storageDir = resolvePath(storageDir);
+	store->setup(this->storageDir);
+
+	enqueueOnly = !runUploader;
+	if(runUploader){
+		if(!getTransport()){
+			LOG_ERROR << "no Transport set! jobs will fail until you setTransport()";
+		}
+		running = true;
+		thread = std::thread(&ofxUserContentUploadCore::threadedFunction, this);
+	}
+}
+
+
+void ofxUserContentUploadCore::stop(){
+	running = false;
+	shared_ptr<Transport> t = getTransport();
+	if(t && thread.joinable()){
+		t->cancelJobs(); //don't wait for a long upload to finish
+	}
+	if(thread.joinable()){
+		thread.join();
+	}
+}
+
+
+void ofxUserContentUploadCore::addJob(Job & job){
+
+	if(!storageDir.size()){
+		LOG_ERROR << "Can't addJob()! ofxUserContentUpload is Not Setup!";
+		return;
+	}
+	LOG_NOTICE << "adding a new job '" << job.jobID << "'.";
+	Job j = job;
+	j.queueID = getNewULID();
+	if(j.timeStamp == 0){ //creation time as the upload thread sees it, so expiry works in virtual time too
+		j.timeStamp = (int)clock->getUnixTime();
+	}
+	if(j.timeToLive > 0){
+		j.expiryTime = j.timeStamp + j.timeToLive;
+	}
+	for(auto & f : j.fileFields){ //the uploader might run from somewhere else
+		f.second.first = resolvePath(f.second.first);
+	}
+	if(enqueueOnly){ //no upload thread here - hand it over to the uploader process right away
+		store->save(j, store->fileNameForJob(j), false);
+		return;
+	}
+	std::lock_guard<std::mutex> lock(mutex);
+	pendingApiRequests.push_back(j);
+}
+
+
+void ofxUserContentUploadCore::threadedFunction(){
+
+	int c = 0;
+	expiryWheel.start(clock->getUnixTime());
+
+	//get the jobs left on disk by previous runs into the expiry wheel & ordering state
+	updateJobFiles(false);
+	updateJobFiles(true);
+
+	while(running){
+
+		//sleep N/2 seconds b4 trying to execute the next job
+		if(!sleepHalfRate()){
+			break; //app exiting - lets stop early!
+		}
+
+		vector<Job> newJobs;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			newJobs.swap(pendingApiRequests);
+		}
+		for(auto & j : newJobs){
+			string fileName = store->fileNameForJob(j);
+			if(store->save(j, fileName, false)){
+				pendingJobFiles.insert(fileName);
+				trackJob(j, fileName, false);
+			}
+		}
+
+		expireJobs();
+		executeNextPendingJob(false); //lets exec a job from the pending list
+
+		if(running){
+
+			//sleep N/2 seconds b4 trying to execute the next FAILED job
+			if(!sleepHalfRate()){
+				break; //app exiting - lets stop early!
+			}
+
+			if(c%failJobSkipRetryFactor == 0){ //once every N times, we try to execute failed jobs
+				executeNextPendingJob(true); //and then lets try run one from the failed list
+			}
+		} //if we are exiting, dont do the 2nd half of the sleeping
+		c++;
+	}
+
+	if(runningJobs.size()){ //their job files stay where they are, they'll be sent next time
+		LOG_WARNING << "abandoning " << runningJobs.size() << " jobs in flight";
+		shared_ptr<Transport> t = getTransport();
+		if(t) t->abortJobs();
+		runningJobs.clear();
+	}
+	LOG_NOTICE << "exiting ofxUserContentUpload thread!";
+}
+
+
+bool ofxUserContentUploadCore::sleepHalfRate(){
+
+	int millis = executeJobsRate * 500;
+	if(clock->isVirtual()){ //sleeping is free, no point in slicing it
+		clock->sleepMillis(millis);
+		return running;
+	}
+
+	//we sleep in small segments to avoid delaying the app quitting. While jobs are in flight,
+	//we spend that time running them instead, and start the next ones as soon as any finishes.
+	double sleepUnit = 0.1;
+	double end = clock->getUnixTime() + millis / 1000.0;
+	while(running){
+		double left = end - clock->getUnixTime();
+		if(left <= 0) return true;
+		if(runningJobs.empty()){
+			clock->sleepMillis(std::max(1, (int)(std::min(left, sleepUnit) * 1000)));
+		}else if(collectJobs(std::min(left, sleepUnit)) && running){
+			executeNextPendingJob(false);
+		}
+	}
+	return false;
+}
+
+
+void ofxUserContentUploadCore::updateJobFiles(bool failedDir){
+
+	if(jobFilesListed[failedDir] && !store->isShared()){
+		return; //nobody else touches the store, so we already know about every job in it
+	}
+	vector<string> fileNames;
+	store->list(failedDir, fileNames);
+	trackJobFiles(fileNames, failedDir);
+
+	std::set<string> listed(fileNames.begin(), fileNames.end());
+	std::set<string> & jobFiles = failedDir ? failedJobFiles : pendingJobFiles;
+	std::set<string> & otherJobFiles = failedDir ? pendingJobFiles : failedJobFiles;
+	for(auto & fileName : jobFiles){ //gone since we last looked (ie deleted by hand) - stop tracking it
+		if(listed.find(fileName) == listed.end() && otherJobFiles.find(fileName) == otherJobFiles.end()){
+			forgetJobFile(fileName);
+		}
+	}
+	jobFiles.swap(listed);
+	jobFilesListed[failedDir] = true;
+}
+
+
+bool ofxUserContentUploadCore::loadJob(const string & fileName, bool failedDir, Job & job){
+	if(!store->load(fileName, failedDir, job)){
+		return false;
+	}
+	if(job.timeStamp == 0){ //ie written by hand, or by an older version
+		job.timeStamp = (int)clock->getUnixTime();
+	}
+	return true;
+}
+
+
+void ofxUserContentUploadCore::executeNextPendingJob(bool fromFailedFolder){
+
+	updateJobFiles(fromFailedFolder);
+	numPendingWhenLastChecked = pendingJobFiles.size();
+	numFailedWhenLastChecked = failedJobFiles.size();
+
+	//transports that can't run jobs in the background run them right in collectJobs(0). Those that can
+	//may have finished some by then while the rest keep going - fill their slots before we sleep again.
+	while(startNextJobs(fromFailedFolder) > 0 && collectJobs(0) && !fromFailedFolder && runningJobs.size() && running){}
+}
+
+
+size_t ofxUserContentUploadCore::startNextJobs(bool fromFailedFolder){
+
+	std::set<string> & fileNames = fromFailedFolder ? failedJobFiles : pendingJobFiles;
+
+	//pick the jobs to start - as many as the transport has room for
+	shared_ptr<Transport> t = getTransport();
+	size_t maxJobs = t ? std::max(t->getMaxConcurrentJobs(), 1) : 1;
+	size_t freeSlots = maxJobs > runningJobs.size() ? maxJobs - runningJobs.size() : 0;
+	vector<string> picked;
+	if(fileNames.size() > 0 && freeSlots > 0){
+		if(!fromFailedFolder){ //oldest first - skipping the ones queued behind a failed job with the same key
+			std::set<string> keysInFlight; //one job per key at a time, or a later one could be done before an earlier one fails
+			for(auto & it : runningJobs){
+				if(it.second.job.orderingKey.size()) keysInFlight.insert(it.second.job.orderingKey);
+			}
+			for(auto it = fileNames.begin(); it != fileNames.end() && picked.size() < freeSlots; ++it){
+				if(runningJobs.count(*it) || isJobFileBlocked(*it) || unreadableJobFiles.count(*it)) continue;
+				auto key = orderingKeysForJobFiles.find(*it);
+				if(key != orderingKeysForJobFiles.end() && !keysInFlight.insert(key->second).second) continue;
+				picked.push_back(*it);
+			}
+		}else{ //we randomly pick one for failed jobs, so that we dont get stuck on the same one forever
+			string fileName = *std::next(fileNames.begin(), std::uniform_int_distribution<int>(0, fileNames.size() - 1)(rng));
+			if(isJobFileBlocked(fileName)){ //never run a job ahead of an older one with the same key
+				fileName = blockedOrderingKeys[orderingKeysForJobFiles[fileName]];
+			}
+			if(!unreadableJobFiles.count(fileName) && !runningJobs.count(fileName)){
+				picked.push_back(fileName);
+			}
+		}
+	}
+
+	for(auto & fileName : picked){
+		Job j;
+		if(!loadJob(fileName, fromFailedFolder, j)){
+			LOG_ERROR << "failed to load job from file '" << fileName << "'";
+		}else if(j.expiryTime > 0 && j.expiryTime <= clock->getUnixTime()){ //its timer might not have fired yet
+			expireJob(j, fileName, fromFailedFolder);
+		}else{
+			startJob(j, fileName, fromFailedFolder);
+		}
+	}
+	return picked.size();
+}
+
+
+void ofxUserContentUploadCore::handleJobResult(Job & j, const string & fileName, bool fromFailedFolder, JobExecutionResult & r){
+
+	r.outcome = r.ok ? JOB_SUCCEEDED : JOB_FAILED_WILL_RETRY;
+
+	if(r.ok){
+		LOG_NOTICE << "Delete Job '" << j.jobID << "'  file: '" << fileName << "'";
+		removeJobFile(fileName, fromFailedFolder);
+		numExecutedOkJobs++;
+	}else{
+		numExecutedFailedJobs++;
+		if(fromFailedFolder){
+			if (j.numTries > maxJobRetries){
+				LOG_ERROR << "JOB FAILED AGAIN '" << j.jobID << "' - FOR THE LAST TIME! (" << j.numTries << ") deleting it '" << fileName << "'";
+				removeJobFile(fileName, true);
+				deleteFilesForJob(j); //remove job-related files too
+				r.outcome = JOB_FAILED_DROPPED;
+			}else{
+				LOG_ERROR << "JOB FAILED AGAIN '" << j.jobID << "'  - failed " << j.numTries << " times so far (max " << maxJobRetries <<  "). '" << fileName << "'";
+				store->remove(fileName, true);
+				failedJobFiles.erase(fileName);
+				j.numTries++;
+				string newFileName = store->fileNameForJob(j);
+				if(store->save(j, newFileName, true)){ //save it back into the fail dir
+					failedJobFiles.insert(newFileName);
+				}
+			}
+		}else{
+			LOG_ERROR << "JOB FAILED '" << j.jobID << "' Moving job to failed dir: '" << fileName << "'";
+			if(store->moveToFailed(fileName)){ //transfer job fom PENDING to FAILED
+				pendingJobFiles.erase(fileName);
+				failedJobFiles.insert(fileName);
+			}
+			if(j.orderingKey.size()){ //the rest of its key waits for it
+				blockedOrderingKeys[j.orderingKey] = fileName;
+			}
+		}
+	}
+
+	r.jobID = j.jobID;
+	r.isJobFresh = !fromFailedFolder;
+	reportResult(r);
+
+	if(r.outcome == JOB_FAILED_DROPPED && j.orderingKey.size()){ //the rest of its key can't go ahead without it
+		dropOrderingKey(j.orderingKey, j, fileName);
+	}
+}
+
+
+void ofxUserContentUploadCore::reportResult(const JobExecutionResult & r){
+	if(onJobExecuted){
+		onJobExecuted(r);
+	}else{
+		std::lock_guard<std::mutex> lock(mutex);
+		executedJobs.push_back(r);
+	}
+}
+
+
+void ofxUserContentUploadCore::trackJobFiles(vector<string> & fileNames, bool failedDir){
+
+	for(auto & fileName : fileNames){
+		if(knownJobFiles.find(fileName) != knownJobFiles.end()) continue;
+		Job j;
+		if(loadJob(fileName, failedDir, j)){
+			string newFileName = store->fileNameForJob(j);
+			if(newFileName != fileName && store->save(j, newFileName, failedDir)){ //saved by an older version - persist its queueID
+				LOG_NOTICE << "renaming job file '" << fileName << "' to '" << newFileName << "'";
+				store->remove(fileName, failedDir);
+				fileName = newFileName;
+			}
+			trackJob(j, fileName, failedDir);
+		}else{ //known too, so we don't try to parse it again every time we look - until it's gone
+			LOG_ERROR << "can't read job file '" << fileName << "', skipping it until it's removed";
+			knownJobFiles.insert(fileName);
+			unreadableJobFiles.insert(fileName);
+		}
+	}
+}
+
+
+void ofxUserContentUploadCore::trackJob(const Job & j, const string & fileName, bool failedDir){
+
+	if(!knownJobFiles.insert(fileName).second) return;
+	if(j.expiryTime > 0){
+		expiryWheel.add(j.expiryTime, fileName);
+	}
+	if(j.orderingKey.size()){
+		orderingKeysForJobFiles[fileName] = j.orderingKey;
+		//we track them in name order, so the first failed job of each key is the one holding it back
+		if(failedDir && blockedOrderingKeys.find(j.orderingKey) == blockedOrderingKeys.end()){
+			blockedOrderingKeys[j.orderingKey] = fileName;
+		}
+	}
+}
+
+
+bool ofxUserContentUploadCore::isJobFileBlocked(const string & fileName){
+	auto it = orderingKeysForJobFiles.find(fileName);
+	if(it == orderingKeysForJobFiles.end()) return false;
+	auto blocked = blockedOrderingKeys.find(it->second);
+	return blocked != blockedOrderingKeys.end() && blocked->second != fileName;
+}
+
+
+void ofxUserContentUploadCore::expireJobs(){
+
+	vector<string> expired;
+	expiryWheel.advance(clock->getUnixTime(), expired);
+
+	for(auto & fileName : expired){ //timers can't be cancelled, so the job might be gone already
+		if(runningJobs.count(fileName)) continue; //being sent - if it fails, it's checked again before its next try
+		bool inFailedFolder = true;
+		if(!store->exists(fileName, true)){
+			inFailedFolder = false;
+			if(!store->exists(fileName, false)){
+				knownJobFiles.erase(fileName);
+				continue;
+			}
+		}
+		Job j;
+		if(loadJob(fileName, inFailedFolder, j) && j.expiryTime > 0){
+			expireJob(j, fileName, inFailedFolder);
+		}
+	}
+}
+
+
+void ofxUserContentUploadCore::expireJob(const Job & j, const string & fileName, bool fromFailedFolder){
+
+	LOG_WARNING << "JOB EXPIRED '" << j.jobID << "' before it could be sent, deleting it '" << fileName << "'";
+	removeJobFile(fileName, fromFailedFolder);
+	deleteFilesForJob(j);
+	numExpiredJobs++;
+	reportResult(unsentJobResult(j, JOB_EXPIRED, fromFailedFolder, "Job expired"));
+
+	if(j.orderingKey.size()){ //the rest of its key can't go ahead without it
+		dropOrderingKey(j.orderingKey, j, fileName);
+	}
+}
+
+
+void ofxUserContentUploadCore::dropOrderingKey(const string & orderingKey, const Job & droppedJob, const string & droppedFileName){
+
+	//job file names sort in queue order, so the jobs queued behind it are the ones that sort after it
+	vector<string> fileNames;
+	for(auto & it : orderingKeysForJobFiles){
+		if(it.second == orderingKey && it.first > droppedFileName) fileNames.push_back(it.first);
+	}
+
+	for(auto & fileName : fileNames){
+		bool failedDir = failedJobFiles.find(fileName) != failedJobFiles.end();
+		Job j;
+		bool loaded = loadJob(fileName, failedDir, j);
+		removeJobFile(fileName, failedDir);
+		if(!loaded) continue; //was gone already
+		LOG_ERROR << "DROPPING JOB '" << j.jobID << "' - job '" << droppedJob.jobID << "' before it with ordering key '"
+			<< orderingKey << "' will never be sent. deleting it '" << fileName << "'";
+		deleteFilesForJob(j);
+		reportResult(unsentJobResult(j, JOB_FAILED_DROPPED, failedDir,
+			"Dropped, job '" + droppedJob.jobID + "' before it with ordering key '" + orderingKey + "' will never be sent"));
+	}
+}
+
+
+ofxUserContentUploadCore::JobExecutionResult ofxUserContentUploadCore::unsentJobResult(const Job & j, JobOutcome outcome, bool fromFailedFolder, const string & description){
+	JobExecutionResult r;
+	r.ok = false;
+	r.outcome = outcome;
+	r.isJobFresh = !fromFailedFolder;
+	r.numTries = j.numTries;
+	r.time = clock->getUnixTime();
+	r.jobID = j.jobID;
+	r.errorDescription = description;
+	r.serverStatusCode = -1;
+	r.timeOut = 0; //never attempted
+	r.duration = 0;
+	return r;
+}
+
+
+void ofxUserContentUploadCore::removeJobFile(const string & fileName, bool failedDir){
+	store->remove(fileName, failedDir);
+	(failedDir ? failedJobFiles : pendingJobFiles).erase(fileName);
+	forgetJobFile(fileName);
+}
+
+
+void ofxUserContentUploadCore::forgetJobFile(const string & fileName){
+	knownJobFiles.erase(fileName);
+	unreadableJobFiles.erase(fileName);
+
+	auto it = orderingKeysForJobFiles.find(fileName);
+	if(it != orderingKeysForJobFiles.end()){ //let the rest of its key go ahead
+		auto blocked = blockedOrderingKeys.find(it->second);
+		if(blocked != blockedOrderingKeys.end() && blocked->second == fileName){
+			blockedOrderingKeys.erase(blocked);
+		}
+		orderingKeysForJobFiles.erase(it);
+	}
+}
+
+
+void ofxUserContentUploadCore::startJob(const Job & j, const string & fileName, bool fromFailedFolder){
+
+	LOG_NOTICE << separator1 << "Starting Job: \"" << j.jobID << "\"" << separator2 ;
+	RunningJob & rj = runningJobs[fileName]; //map nodes don't move, so the transport can keep pointers to it
+	rj.job = j;
+	rj.fromFailedFolder = fromFailedFolder;
+	rj.payloadSize = payloadSizeForJob(rj.job);
+	rj.submission.job = &rj.job;
+	timeOutsForJob(rj.job, rj.payloadSize, rj.submission.connectTimeOut, rj.submission.timeOut);
+
+	shared_ptr<Transport> t = getTransport();
+	if(t){
+		t->startJob(&rj.submission);
+	}
+}
+
+
+bool ofxUserContentUploadCore::collectJobs(float maxWait){
+
+	if(runningJobs.empty()) return false;
+
+	vector<JobSubmission*> finished;
+	shared_ptr<Transport> t = getTransport();
+	if(t){
+		t->runJobs(maxWait, finished);
+	}else{
+		for(auto & it : runningJobs){
+			it.second.submission.response.url = it.second.job.host;
+			it.second.submission.response.reasonForStatus = "no Transport set!";
+			finished.push_back(&it.second.submission);
+		}
+	}
+
+	for(auto s : finished){
+		auto it = runningJobs.begin();
+		while(it != runningJobs.end() && &it->second.submission != s) ++it;
+		if(it == runningJobs.end()) continue;
+		if(!running && s->response.status < 0) continue; //cancelled by stop() - left for the next run, untouched
+		string fileName = it->first;
+		JobExecutionResult r;
+		finishJob(it->second, r);
+		handleJobResult(it->second.job, fileName, it->second.fromFailedFolder, r);
+		runningJobs.erase(fileName);
+	}
+	return finished.size() > 0;
+}
+
+
+void ofxUserContentUploadCore::finishJob(RunningJob & rj, JobExecutionResult & result){
+
+	const Job & j = rj.job;
+	TransportResponse & r = rj.submission.response;
+	result.numTries = j.numTries;
+	result.timeOut = rj.submission.timeOut;
+	result.duration = r.totalTime;
+	result.time = clock->getUnixTime();
+	updateHostStats(j, rj.payloadSize, r, rj.submission.timeOut);
+
+	string serverMsg;
+	int statusCode = analyzeStatus(r, serverMsg, j.verbose);
+	printStatus(j.jobID, r, serverMsg, statusCode);
+
+	LOG_NOTICE << separator1 << "Job Executed \"" << j.jobID << "\"" << separator2;
+	if(j.verbose){
+		LOG_NOTICE << "Verbose Summary : url: " << r.url << " status: " << r.status << " (" << r.reasonForStatus
+			<< ") time: " << r.totalTime << " sec\n" << r.responseBody;
+	}else{
+		LOG_NOTICE << "Server Response : " << r.responseBody;
+	}
+
+	result.serverResponse = r.responseBody;
+	result.serverStatusCode = statusCode;
+	result.errorDescription = serverMsg + " | " + r.reasonForStatus;
+
+	bool shouldRetryJoblater = shouldRetryJobLater(statusCode);
+	if(!shouldRetryJoblater){
+		deleteFilesForJob(j);
+	}else{
+		LOG_ERROR << "Job failed '" << j.jobID << "', we will retry again later.";
+	}
+	result.ok = !shouldRetryJoblater;
+}
+
+
+void ofxUserContentUploadCore::setAdaptiveTimeOuts(bool enabled, float minTimeOut, float maxTimeOut){
+	std::lock_guard<std::mutex> lock(mutex);
+	adaptiveTimeOuts = enabled;
+	minAdaptiveTimeOut = minTimeOut;
+	maxAdaptiveTimeOut = std::max(minTimeOut, maxTimeOut);
+}
+
+
+string ofxUserContentUploadCore::hostKeyForJob(const Job & j){
+	string host = j.host;
+	size_t schemeEnd = host.find("://");
+	if(schemeEnd != string::npos) host = host.substr(schemeEnd + 3);
+	return host.substr(0, host.find('/')) + ":" + std::to_string(j.port);
+}
+
+
+uint64_t ofxUserContentUploadCore::payloadSizeForJob(const Job & j){
+	uint64_t size = 0;
+	for(auto & ff : j.formFields){
+		size += ff.first.size() + ff.second.size();
+	}
+	for(auto & ff : j.fileFields){
+		std::error_code err;
+		uintmax_t s = fs::file_size(ff.second.first, err);
+		if(!err) size += s;
+	}
+	return size;
+}
+
+
+//jobs smaller than this mostly measure RTT (+ server time), larger ones measure throughput
+static const uint64_t smallPayloadSize = 64 * 1024;
+static const float ewmaAlpha = 0.3;
+
+
+void ofxUserContentUploadCore::timeOutsForJob(const Job & j, uint64_t payloadSize, float & connectTimeOut, float & totalTimeOut){
+
+	bool adaptive;
+	float minTimeOut, maxTimeOut;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		adaptive = adaptiveTimeOuts;
+		minTimeOut = minAdaptiveTimeOut;
+		maxTimeOut = maxAdaptiveTimeOut;
+	}
+
+	connectTimeOut = totalTimeOut = timeOut;
+	if(!adaptive) return;
+
+	auto it = hostStats.find(hostKeyForJob(j));
+	if(it == hostStats.end()) return; //nothing measured yet, use the default
+
+	const HostStats & h = it->second;
+	if(h.rtt > 0){
+		connectTimeOut = std::min(std::max(h.rtt * 4, minTimeOut), timeOut);
+	}
+	if(payloadSize <= smallPayloadSize){
+		totalTimeOut = h.rtt > 0 ? h.rtt * 4 : timeOut;
+	}else if(h.throughput > 0){ //give it 3x the expected transfer time
+		totalTimeOut = std::max(h.rtt, 0.0f) * 4 + 3 * payloadSize / h.throughput;
+	}
+	totalTimeOut = std::min(std::max(totalTimeOut, minTimeOut), maxTimeOut);
+	if(payloadSize <= smallPayloadSize){ //only large jobs get more patience than the default
+		totalTimeOut = std::min(totalTimeOut, timeOut);
+	}
+	connectTimeOut = std::min(connectTimeOut, totalTimeOut);
+}
+
+
+void ofxUserContentUploadCore::updateHostStats(const Job & j, uint64_t payloadSize, TransportResponse & r, float usedTimeOut){
+
+	HostStats & h = hostStats[hostKeyForJob(j)];
+	bool small = payloadSize <= smallPayloadSize;
+
+	if(r.status != -1){ //got a response, learn from it
+		if(small){
+			h.rtt = h.rtt < 0 ? r.totalTime : h.rtt + (r.totalTime - h.rtt) * ewmaAlpha;
+		}else{
+			float transferTime = std::max(r.totalTime - std::max(h.rtt, 0.0f), 0.001f);
+			float throughput = payloadSize / transferTime;
+			h.throughput = h.throughput < 0 ? throughput : h.throughput + (throughput - h.throughput) * ewmaAlpha;
+		}
+	}else if(r.totalTime >= usedTimeOut * 0.95 && !small){ //a large job timed out - be more patient next time
+		float throughput = payloadSize / std::max(usedTimeOut, 0.001f); //its at least this slow
+		h.throughput = h.throughput < 0 ? throughput / 2 : std::min(h.throughput, throughput) / 2;
+	}
+	//a small job timing out says nothing about the RTT (the host might just be down), so we keep it -
+	//a dead host costs the same (at most getTimeOut()) on every retry rather than more and more.
+}
+
+
+void ofxUserContentUploadCore::deleteFilesForJob(const Job & job){
+	for(auto file : job.fileFields){ //delete all uploaded files - job will not be retried
+		if(file.second.first.size()){
+			LOG_NOTICE << "Removing user content file at \"" << file.second.first << "\"" << " attached to JOB \"" << job.jobID << "\"";
+			std::error_code err;
+			fs::remove(resolvePath(file.second.first), err);
+		}
+	}
+}
+
+
+bool ofxUserContentUploadCore::shouldRetryJobLater(int c){
+
+	auto it = retryPolicy.find(c);
+	if(it == retryPolicy.end()){
+		return true; //if not defined in the policy, we retry later!
+	}else{
+		return it->second;
+	}
+}
+
+
+//standard reason phrases, so error descriptions don't depend on what each server puts in its status line
+static string reasonForStatus(int status){
+	switch(status){
+		case 200: return "OK";
+		case 201: return "Created";
+		case 202: return "Accepted";
+		case 204: return "No Content";
+		case 301: return "Moved Permanently";
+		case 302: return "Found";
+		case 304: return "Not Modified";
+		case 400: return "Bad Request";
+		case 401: return "Unauthorized";
+		case 403: return "Forbidden";
+		case 404: return "Not Found";
+		case 405: return "Method Not Allowed";
+		case 408: return "Request Time-out";
+		case 410: return "Gone";
+		case 413: return "Request Entity Too Large";
+		case 429: return "Too Many Requests";
+		case 500: return "Internal Server Error";
+		case 502: return "Bad Gateway";
+		case 503: return "Service Unavailable";
+		case 504: return "Gateway Time-out";
+		default: return "???";
+	}
+}
+
+
+int ofxUserContentUploadCore::analyzeStatus(TransportResponse & r, string &serverMessage, bool verbose){
+	//TODO parse server response with user lambda?
+	serverMessage = r.status != -1 ? reasonForStatus(r.status) : r.reasonForStatus;
+	return r.status;
+}
+
+
+void ofxUserContentUploadCore::printStatus(const string & jobID, TransportResponse & r, const string & serverMsg, int status){
+
+	switch (status) {
+		case 200:
+			LOG_NOTICE << "Job \"" << jobID << "\" \"" << r.url << "\"" << " FINISHED OK!! '"
+				<< status << "' took " << r.totalTime << " sec";
+			break;
+
+		default:
+			LOG_ERROR << "Job \"" << jobID << "\" \"" << r.url << "\"" << " FAILED!!   Status: '"
+				<< status << "'  Reason: '" << serverMsg << "' http("
+				<< r.reasonForStatus << ") took " << r.totalTime << " sec";
+			break;
+	}
+}
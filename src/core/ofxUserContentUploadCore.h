@@ -0,0 +1,182 @@
+//
+//  ofxUserContentUploadCore.h
+//  ofxUserContentUpload
+//
+//  The queue & upload engine: persists jobs to storageDir, runs them from its own thread,
+//  retries, expires and orders them. No openFrameworks in here - the addon (ofxUserContentUpload)
+//  is a thin layer on top, and the headless daemon (daemon/) uses it directly.
+//
+
+#pragma once
+
+#include "ofxUserContentUploadTypes.h"
+#include "ofxUserContentUploadJobStore.h"
+#include "ofxUserContentUploadTimerWheel.h"
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <random>
+#include <set>
+
+class ofxUserContentUploadCore : public ofxUserContentUploadTypes{
+
+public:
+
+	ofxUserContentUploadCore();
+	virtual ~ofxUserContentUploadCore();
+
+	//runUploader == false makes this a thin enqueue client: addJob() writes jobs straight to
+	//storageDir/pending, and another process (ie the daemon) uploads them.
+	void setup(const string & storageDir, FailedJobPolicy retryPolicy = getDefaultRetryPolicy(), bool runUploader = true);
+	//stops the upload thread. Jobs in flight are cancelled and stay queued; transports that can't
+	//cancel (ie HttpFormTransport) are waited for, up to their time out.
+	void stop();
+
+	void addJob(Job & job);
+
+	//results are queued until collected with takeExecutedJobs()... or set onJobExecuted
+	//(before setup()) to get each one right away, called from the upload thread.
+	void takeExecutedJobs(vector<JobExecutionResult> & results);
+	std::function<void(const JobExecutionResult & result)> onJobExecuted;
+
+	struct Status{
+		int numPending;
+		int numFailed;
+		int numExecutedOk;
+		int numExecutedFailed;
+		int numExpired;
+		bool enqueueOnly;
+	};
+	Status getStatus();
+
+	//relative storageDir & attachment paths are resolved against this (defaults to the working dir)
+	void setDataPath(const string & path){ dataPath = path; }
+
+	void setTransport(shared_ptr<Transport> t);
+	shared_ptr<Transport> getTransport();
+	void setClock(shared_ptr<Clock> c); //defaults to SystemClock - call before setup()
+	shared_ptr<Clock> getClock();
+	//where the job queue is kept - defaults to job files in storageDir - call before setup()
+	void setJobStore(shared_ptr<ofxUserContentUploadJobStore> s);
+	void setRandomSeed(unsigned int seed); //for the failed job picks - call before setup() for repeatable runs
+
+	void setMaxNumberRetries(int n){ maxJobRetries = n;} //if a job failed to send (and keeps failing)it will only be re-tried N times at max
+	int& getMaxNumRetries(){return maxJobRetries;} //all files will be deleted for that job
+	void setTimeOut(float timeOut_){timeOut = timeOut_;}
+	float& getTimeOut(){return timeOut;}
+	//derive each job's time outs from the measured RTT & throughput of its host and the size
+	//of its payload; getTimeOut() is used for hosts we know nothing about yet.
+	void setAdaptiveTimeOuts(bool enabled, float minTimeOut = 5, float maxTimeOut = 600);
+	float& getExecuteJobsRate(){return executeJobsRate;} //seconds - look if there's jobs pending every N seconds
+	int& getFailJobSkipRetryFactor(){return failJobSkipRetryFactor;}
+
+protected:
+
+	string resolvePath(const string & path);
+
+	FailedJobPolicy retryPolicy;
+	shared_ptr<Transport> transport;
+	shared_ptr<Clock> clock;
+	std::mt19937 rng; //only used from the upload thread
+	std::mutex mutex;
+
+	vector<Job> pendingApiRequests;
+	shared_ptr<ofxUserContentUploadJobStore> store;
+
+	std::thread thread;
+	std::atomic<bool> running;
+	void threadedFunction();
+	bool sleepHalfRate(); //false if we are stopping
+	bool enqueueOnly = false;
+	string dataPath;
+
+	void executeNextPendingJob(bool fromFailedFolder); //start as many pending jobs as there's room for, or one failed job
+
+	//expiry & ordering - only touched from the upload thread
+	ofxUserContentUploadTimerWheel expiryWheel; //keys are job file names
+	std::set<string> knownJobFiles; //job files already loaded into the expiry wheel & ordering state - until they are gone
+	std::set<string> unreadableJobFiles; //known job files we couldn't parse - never picked to run
+	std::set<string> pendingJobFiles; //sorted like the store lists them - oldest first
+	std::set<string> failedJobFiles;
+	bool jobFilesListed[2] = {false, false}; //pending, failed
+	void updateJobFiles(bool failedDir); //re-list the store, unless no one else can change it
+	bool loadJob(const string & fileName, bool failedDir, Job & job);
+	map<string, string> orderingKeysForJobFiles; //fileName : orderingKey - only jobs that have one
+	map<string, string> blockedOrderingKeys; //orderingKey : fileName of the failed job holding that key back
+	void trackJobFiles(vector<string> & fileNames, bool failedDir); //load the new job files found on disk, schedule their expiry - renames legacy ones
+	void trackJob(const Job & job, const string & fileName, bool failedDir);
+	bool isJobFileBlocked(const string & fileName); //is it queued behind a failed job with the same ordering key?
+	void expireJobs(); //drop the jobs whose timers fired
+	void expireJob(const Job & job, const string & fileName, bool fromFailedFolder);
+	void removeJobFile(const string & fileName, bool failedDir);
+	void forgetJobFile(const string & fileName); //drop all we track about a job file that's gone
+	void dropOrderingKey(const string & orderingKey, const Job & droppedJob, const string & droppedFileName); //drop the jobs queued behind one that will never be sent
+	JobExecutionResult unsentJobResult(const Job & job, JobOutcome outcome, bool fromFailedFolder, const string & description);
+	void reportResult(const JobExecutionResult & r);
+
+	//jobs handed to the transport that haven't finished yet - only touched from the upload thread
+	struct RunningJob{
+		Job job;
+		bool fromFailedFolder = false;
+		uint64_t payloadSize = 0;
+		JobSubmission submission;
+	};
+	map<string, RunningJob> runningJobs; //fileName : job in flight
+	size_t startNextJobs(bool fromFailedFolder); //returns how many it picked
+	void startJob(const Job & job, const string & fileName, bool fromFailedFolder);
+	bool collectJobs(float maxWait); //handle the jobs that finished within maxWait seconds - true if any did
+	void finishJob(RunningJob & rj, JobExecutionResult & result);
+	void handleJobResult(Job & job, const string & fileName, bool fromFailedFolder, JobExecutionResult & r); //delete, retry or drop it
+
+	void printStatus(const string & jobID,
+					 TransportResponse & r,
+					 const string & serverMsg,
+					 int status);
+
+	float timeOut;
+
+	vector<JobExecutionResult> executedJobs;
+
+	float executeJobsRate; //seconds
+	int failJobSkipRetryFactor; //N times executeJobsRate
+
+	std::atomic<int> numExecutedOkJobs;
+	std::atomic<int> numExecutedFailedJobs;
+	std::atomic<int> numExpiredJobs;
+
+	int maxJobRetries = 50;
+
+	string storageDir;
+
+	std::atomic<int> numPendingWhenLastChecked;
+	std::atomic<int> numFailedWhenLastChecked;
+
+	bool shouldRetryJobLater(int status); //this decides if a job is to give up or retry later if it failed
+	int analyzeStatus(TransportResponse & r, string &serverMessage, bool verbose);
+
+	void deleteFilesForJob(const Job & job);
+
+	//adaptive time outs - only touched from the upload thread (but for the settings)
+	struct HostStats{
+		float rtt = -1; //EWMA of how long small jobs take - seconds, -1 if unknown
+		float throughput = -1; //EWMA of bytes per second on large jobs, -1 if unknown
+	};
+	map<string, HostStats> hostStats; //"host:port"
+	bool adaptiveTimeOuts = false;
+	float minAdaptiveTimeOut = 5;
+	float maxAdaptiveTimeOut = 600;
+
+	static string hostKeyForJob(const Job & job);
+	static uint64_t payloadSizeForJob(const Job & job);
+	void timeOutsForJob(const Job & job, uint64_t payloadSize, float & connectTimeOut, float & totalTimeOut);
+	void updateHostStats(const Job & job, uint64_t payloadSize, TransportResponse & r, float usedTimeOut);
+
+#ifdef _WIN32
+	const string separator1 = "$$$$$$$$$$$$$$$$$$$  ";
+	const string separator2 = "  $$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$";
+#else
+	const string separator1 = "░░░░░░░░░░░░░░░░░░░  ";
+	const string separator2 = " ░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░";
+
+#endif
+};
@@ -0,0 +1,298 @@
+//
+//  ofxUserContentUploadCurlTransport.cpp
+//  ofxUserContentUpload
+//
+
+#include "ofxUserContentUploadCurlTransport.h"
+
+#if defined(__has_include)
+	#if !__has_include(<curl/curl.h>)
+		//a transport that can't send would fail, retry & finally drop every job - deleting its files
+		#error "ofxUserContentUpload needs libcurl: add its headers to the include paths and link -lcurl (openFrameworks bundles it)"
+	#endif
+#endif
+
+#include <curl/curl.h>
+#include <filesystem>
+#include <mutex>
+#include <algorithm>
+#include <chrono>
+#include <set>
+#ifndef _WIN32
+	#include <sys/socket.h>
+	#include <netinet/in.h>
+	#include <netinet/tcp.h>
+#endif
+
+//one job in flight
+struct ofxUserContentUploadCurlTransport::Transfer{
+	JobSubmission * submission = nullptr;
+	unsigned int cancelCount = 0; //the transport's, when it started
+	CURL * easy = nullptr;
+	curl_mime * mime = nullptr;
+	struct curl_slist * headers = nullptr;
+	string statusLine;
+	char error[CURL_ERROR_SIZE];
+};
+
+
+namespace{
+
+	size_t onBody(char * data, size_t size, size_t n, void * userData){
+		((string*)userData)->append(data, size * n);
+		return size * n;
+	}
+
+	size_t onHeader(char * data, size_t size, size_t n, void * userData){
+		string line(data, size * n);
+		if(line.compare(0, 5, "HTTP/") == 0){ //the last one wins (ie after a "100 Continue")
+			*(string*)userData = line.substr(0, line.find_last_not_of("\r\n") + 1);
+		}
+		return size * n;
+	}
+
+	int onSocket(void *, curl_socket_t socket, curlsocktype purpose){
+		#ifdef TCP_NOTSENT_LOWAT
+		//don't let the kernel queue up megabytes of a large upload: over HTTP/2, the frames of the
+		//small jobs sharing the connection would wait behind them. Doesn't limit the tcp window.
+		int lowat = 128 * 1024;
+		setsockopt(socket, IPPROTO_TCP, TCP_NOTSENT_LOWAT, &lowat, sizeof(lowat));
+		#endif
+		return CURL_SOCKOPT_OK;
+	}
+
+	bool hasExplicitPort(const string & url){
+		size_t start = url.find("://");
+		start = start == string::npos ? 0 : start + 3;
+		string authority = url.substr(start, url.find('/', start) - start);
+		size_t bracket = authority.rfind(']'); //ipv6 literal
+		size_t colon = authority.rfind(':');
+		return colon != string::npos && (bracket == string::npos || colon > bracket);
+	}
+}
+
+
+ofxUserContentUploadCurlTransport::ofxUserContentUploadCurlTransport(HttpVersion version, int maxConcurrentJobs){
+
+	static std::once_flag curlInit;
+	std::call_once(curlInit, [](){ curl_global_init(CURL_GLOBAL_DEFAULT); });
+
+	this->version = version;
+	this->maxConcurrentJobs = std::max(maxConcurrentJobs, 1);
+	multi = curl_multi_init();
+	curl_multi_setopt(multi, CURLMOPT_PIPELINING, (long)CURLPIPE_MULTIPLEX);
+	curl_multi_setopt(multi, CURLMOPT_MAX_HOST_CONNECTIONS, (long)this->maxConcurrentJobs);
+}
+
+
+ofxUserContentUploadCurlTransport::~ofxUserContentUploadCurlTransport(){
+	abortJobs();
+	curl_multi_cleanup(multi);
+}
+
+
+void ofxUserContentUploadCurlTransport::startJob(JobSubmission * submission){
+
+	const Job & job = *submission->job;
+	TransportResponse & r = submission->response;
+	r.url = job.host;
+
+	uint64_t payloadSize = 0; //same as the upload thread counts it, so "small" means the same to both
+	for(auto & ff : job.formFields){
+		payloadSize += ff.first.size() + ff.second.size();
+	}
+	for(auto & ff : job.fileFields){
+		std::error_code err;
+		uintmax_t s = std::filesystem::file_size(ff.second.first, err);
+		if(err){
+			r.status = -1;
+			r.reasonForStatus = "can't open file to upload: '" + ff.second.first + "'";
+			doneJobs.push_back(submission); //never started
+			return;
+		}
+		payloadSize += s;
+	}
+
+	std::unique_ptr<Transfer> transfer(new Transfer());
+	Transfer & t = *transfer;
+	t.submission = submission;
+	t.cancelCount = cancelCount;
+	t.error[0] = 0;
+
+	string url = job.host.find("://") == string::npos ? "http://" + job.host : job.host;
+	t.easy = curl_easy_init();
+	curl_easy_setopt(t.easy, CURLOPT_URL, url.c_str());
+	if(url.compare(0, 7, "http://") == 0 && !hasExplicitPort(url)){
+		curl_easy_setopt(t.easy, CURLOPT_PORT, (long)job.port);
+	}
+	switch(version){
+		case HTTP_1_1: curl_easy_setopt(t.easy, CURLOPT_HTTP_VERSION, (long)CURL_HTTP_VERSION_1_1); break;
+		case HTTP_2: curl_easy_setopt(t.easy, CURLOPT_HTTP_VERSION, (long)CURL_HTTP_VERSION_2TLS); break;
+		case HTTP_2_PRIOR_KNOWLEDGE: curl_easy_setopt(t.easy, CURLOPT_HTTP_VERSION, (long)CURL_HTTP_VERSION_2_PRIOR_KNOWLEDGE); break;
+	}
+	//wait to multiplex on the host's connection rather than opening another. Not for h2c: curl only
+	//learns a fresh h2c connection can multiplex once its first response is in, so every job would
+	//wait for the first one (ie a whole video upload) - it reuses the connection once it knows.
+	if(version == HTTP_2){
+		curl_easy_setopt(t.easy, CURLOPT_PIPEWAIT, 1L);
+	}
+	curl_easy_setopt(t.easy, CURLOPT_STREAM_WEIGHT, payloadSize <= smallJobSize ? 256L : 16L);
+	curl_easy_setopt(t.easy, CURLOPT_CONNECTTIMEOUT_MS, (long)(submission->connectTimeOut * 1000));
+	curl_easy_setopt(t.easy, CURLOPT_TIMEOUT_MS, (long)(submission->timeOut * 1000));
+	curl_easy_setopt(t.easy, CURLOPT_NOSIGNAL, 1L);
+	curl_easy_setopt(t.easy, CURLOPT_SOCKOPTFUNCTION, onSocket);
+	curl_easy_setopt(t.easy, CURLOPT_USERAGENT, "ofxUserContentUpload");
+	curl_easy_setopt(t.easy, CURLOPT_WRITEFUNCTION, onBody);
+	curl_easy_setopt(t.easy, CURLOPT_WRITEDATA, &r.responseBody);
+	curl_easy_setopt(t.easy, CURLOPT_HEADERFUNCTION, onHeader);
+	curl_easy_setopt(t.easy, CURLOPT_HEADERDATA, &t.statusLine);
+	curl_easy_setopt(t.easy, CURLOPT_ERRORBUFFER, t.error);
+	curl_easy_setopt(t.easy, CURLOPT_PRIVATE, &t);
+
+	t.headers = curl_slist_append(t.headers, "Accept: */*");
+	t.headers = curl_slist_append(t.headers, "Expect:"); //don't spend a round trip on "100 Continue"
+	curl_easy_setopt(t.easy, CURLOPT_HTTPHEADER, t.headers);
+
+	t.mime = curl_mime_init(t.easy);
+	for(auto & ff : job.formFields){
+		curl_mimepart * part = curl_mime_addpart(t.mime);
+		curl_mime_name(part, ff.first.c_str());
+		curl_mime_data(part, ff.second.c_str(), ff.second.size());
+	}
+	for(auto & ff : job.fileFields){ //streamed from disk as curl sends them
+		curl_mimepart * part = curl_mime_addpart(t.mime);
+		curl_mime_name(part, ff.first.c_str());
+		curl_mime_filedata(part, ff.second.first.c_str());
+		curl_mime_type(part, ff.second.second.c_str());
+	}
+	curl_easy_setopt(t.easy, CURLOPT_MIMEPOST, t.mime);
+
+	curl_multi_add_handle(multi, t.easy);
+	transfers[submission] = std::move(transfer);
+}
+
+
+void ofxUserContentUploadCurlTransport::finishTransfer(Transfer & t, int result){
+
+	TransportResponse & r = t.submission->response;
+	double totalTime = 0;
+	curl_easy_getinfo(t.easy, CURLINFO_TOTAL_TIME, &totalTime);
+	r.totalTime = totalTime;
+	long status = 0;
+	curl_easy_getinfo(t.easy, CURLINFO_RESPONSE_CODE, &status);
+	if(result == CURLE_OK && status > 0){
+		r.status = (int)status;
+		size_t codeStart = t.statusLine.find(' ');
+		size_t reasonStart = codeStart == string::npos ? string::npos : t.statusLine.find(' ', codeStart + 1);
+		r.reasonForStatus = reasonStart == string::npos ? "" : t.statusLine.substr(reasonStart + 1); //HTTP/2 has none
+	}else{
+		r.status = -1;
+		r.responseBody.clear();
+		r.reasonForStatus = t.error[0] ? t.error : curl_easy_strerror((CURLcode)result);
+	}
+	releaseTransfer(t);
+}
+
+
+void ofxUserContentUploadCurlTransport::releaseTransfer(Transfer & t){
+	curl_multi_remove_handle(multi, t.easy);
+	curl_easy_cleanup(t.easy);
+	curl_mime_free(t.mime);
+	curl_slist_free_all(t.headers);
+}
+
+
+void ofxUserContentUploadCurlTransport::runJobs(float maxWait, vector<JobSubmission*> & finished){
+
+	auto deadline = std::chrono::steady_clock::now() + std::chrono::microseconds((int64_t)(maxWait * 1000000));
+	while(true){
+
+		finished.insert(finished.end(), doneJobs.begin(), doneJobs.end());
+		doneJobs.clear();
+		for(auto it = transfers.begin(); it != transfers.end();){
+			if(it->second->cancelCount != cancelCount){
+				finishTransfer(*it->second, CURLE_ABORTED_BY_CALLBACK);
+				it->first->response.reasonForStatus = "cancelled";
+				finished.push_back(it->first);
+				it = transfers.erase(it);
+			}else{
+				++it;
+			}
+		}
+		if(transfers.empty() || finished.size()) return;
+
+		int stillRunning = 0;
+		CURLMcode err = curl_multi_perform(multi, &stillRunning);
+		if(err != CURLM_OK){ //the multi handle is unusable - fail them all rather than spin
+			for(auto & it : transfers){
+				finishTransfer(*it.second, CURLE_FAILED_INIT);
+				it.first->response.reasonForStatus = string("curl_multi_perform failed: ") + curl_multi_strerror(err);
+				finished.push_back(it.first);
+			}
+			transfers.clear();
+			return;
+		}
+
+		CURLMsg * msg;
+		int left;
+		while((msg = curl_multi_info_read(multi, &left))){
+			if(msg->msg == CURLMSG_DONE){
+				Transfer * t;
+				curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, (char**)&t);
+				JobSubmission * s = t->submission;
+				finishTransfer(*t, msg->data.result);
+				transfers.erase(s);
+				finished.push_back(s);
+			}
+		}
+		if(finished.size()) return; //let the upload thread start the next ones right away
+
+		int64_t timeLeft = std::chrono::duration_cast<std::chrono::microseconds>(deadline - std::chrono::steady_clock::now()).count();
+		if(timeLeft <= 0) return;
+		curl_multi_poll(multi, nullptr, 0, (int)std::min<int64_t>((timeLeft + 999) / 1000, 1000), nullptr); //round up, or we spin through the last ms
+	}
+}
+
+
+void ofxUserContentUploadCurlTransport::cancelJobs(){
+	Transport::cancelJobs();
+	curl_multi_wakeup(multi); //don't wait for the poll in runJobs() to time out
+}
+
+
+void ofxUserContentUploadCurlTransport::abortJobs(){
+	for(auto & it : transfers){
+		releaseTransfer(*it.second);
+	}
+	transfers.clear();
+	doneJobs.clear();
+}
+
+
+void ofxUserContentUploadCurlTransport::submitJobs(vector<JobSubmission> & jobs){
+
+	std::set<JobSubmission*> waiting;
+	for(auto & s : jobs){
+		startJob(&s);
+		waiting.insert(&s);
+	}
+	vector<JobSubmission*> others; //started with startJob() by someone else - they get them from their runJobs()
+	while(waiting.size()){
+		vector<JobSubmission*> finished;
+		runJobs(1, finished);
+		for(auto s : finished){
+			if(!waiting.erase(s)) others.push_back(s);
+		}
+	}
+	doneJobs.insert(doneJobs.end(), others.begin(), others.end());
+}
+
+
+ofxUserContentUploadTypes::TransportResponse ofxUserContentUploadCurlTransport::submitJob(const Job & job, float connectTimeOut, float timeOut){
+	vector<JobSubmission> jobs(1);
+	jobs[0].job = &job;
+	jobs[0].connectTimeOut = connectTimeOut;
+	jobs[0].timeOut = timeOut;
+	submitJobs(jobs);
+	return jobs[0].response;
+}
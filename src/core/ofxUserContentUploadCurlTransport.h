@@ -0,0 +1,62 @@
+//
+//  ofxUserContentUploadCurlTransport.h
+//  ofxUserContentUpload
+//
+//  libcurl (multi interface) transport that runs several jobs at once. Over HTTP/2 they go as
+//  concurrent streams of a single connection per host, small jobs weighted ahead of large ones;
+//  over HTTP/1.1 curl opens up to maxConcurrentJobs connections per host instead. Jobs run in the
+//  background between startJob() and runJobs(), so while a video uploads, the upload thread keeps
+//  starting the form posts queued behind it as the other streams free up. Connections are kept
+//  alive between jobs.
+//
+//  upload.setTransport(make_shared<ofxUserContentUploadCurlTransport>());
+//
+//  Needs libcurl built with nghttp2 for HTTP/2 (openFrameworks bundles it; link -lcurl otherwise).
+//  Building without <curl/curl.h> is an error: a transport that can't send would drop every job.
+//
+
+#pragma once
+
+#include "ofxUserContentUploadTypes.h"
+
+class ofxUserContentUploadCurlTransport : public ofxUserContentUploadTypes::Transport{
+
+public:
+
+	typedef ofxUserContentUploadTypes::Job Job;
+	typedef ofxUserContentUploadTypes::TransportResponse TransportResponse;
+	typedef ofxUserContentUploadTypes::JobSubmission JobSubmission;
+
+	enum HttpVersion{
+		HTTP_1_1,
+		HTTP_2, //h2 on https (negotiated, falls back to HTTP/1.1), HTTP/1.1 on plain http
+		HTTP_2_PRIOR_KNOWLEDGE //h2 on plain http too - only if you know the server speaks it (h2c)
+	};
+
+	ofxUserContentUploadCurlTransport(HttpVersion version = HTTP_2, int maxConcurrentJobs = 8);
+	~ofxUserContentUploadCurlTransport();
+
+	TransportResponse submitJob(const Job & job, float connectTimeOut, float timeOut);
+	int getMaxConcurrentJobs(){ return maxConcurrentJobs; }
+	void submitJobs(vector<JobSubmission> & jobs);
+
+	void startJob(JobSubmission * submission);
+	void runJobs(float maxWait, vector<JobSubmission*> & finished);
+	void abortJobs();
+	void cancelJobs();
+
+	void setSmallJobSize(uint64_t bytes){ smallJobSize = bytes; } //jobs up to this size get the high stream weight
+
+protected:
+
+	HttpVersion version;
+	int maxConcurrentJobs;
+	uint64_t smallJobSize = 64 * 1024;
+	void * multi = nullptr; //CURLM - kept across jobs so connections are reused
+
+	struct Transfer;
+	map<JobSubmission*, std::unique_ptr<Transfer>> transfers; //in flight
+	vector<JobSubmission*> doneJobs; //finished, not handed back by runJobs() yet
+	void finishTransfer(Transfer & t, int result); //CURLcode
+	void releaseTransfer(Transfer & t);
+};
@@ -0,0 +1,401 @@
+//
+//  ofxUserContentUploadJobStore.cpp
+//  ofxUserContentUpload
+//
+
+#include "ofxUserContentUploadJobStore.h"
+#include <filesystem>
+#include <fstream>
+#include <algorithm>
+#include <cstring>
+
+namespace fs = std::filesystem;
+
+#define LOG_ERROR	ofxUserContentUploadLog(ofxUserContentUploadLog::LEVEL_ERROR, "ofxUserContentUpload")
+
+
+// minimal xml - just enough for job files ////////////////////////////////////////////////////////
+
+namespace{
+
+	struct XmlNode{
+		string name;
+		map<string, string> attributes;
+		string text;
+		vector<XmlNode> children;
+
+		const XmlNode * child(const string & n) const{
+			for(auto & c : children) if(c.name == n) return &c;
+			return nullptr;
+		}
+		string childText(const string & n, const string & defaultValue) const{
+			const XmlNode * c = child(n);
+			return c ? c->text : defaultValue;
+		}
+		int childInt(const string & n, int defaultValue) const{
+			const XmlNode * c = child(n);
+			if(!c || c->text.empty()) return defaultValue;
+			return atoi(c->text.c_str());
+		}
+		string attribute(const string & n) const{
+			auto it = attributes.find(n);
+			return it != attributes.end() ? it->second : "";
+		}
+	};
+
+	string xmlEscape(const string & s){
+		string out;
+		out.reserve(s.size());
+		for(unsigned char c : s){
+			switch(c){
+				case '&': out += "&amp;"; break;
+				case '<': out += "&lt;"; break;
+				case '>': out += "&gt;"; break;
+				case '"': out += "&quot;"; break;
+				case '\'': out += "&apos;"; break;
+				default:
+					if(c < 32 && c != '\n' && c != '\t'){
+						char buf[8];
+						snprintf(buf, sizeof(buf), "&#x%02X;", c);
+						out += buf;
+					}else{
+						out += c;
+					}
+			}
+		}
+		return out;
+	}
+
+	string xmlUnescape(const string & s){
+		string out;
+		out.reserve(s.size());
+		for(size_t i = 0; i < s.size(); i++){
+			if(s[i] != '&'){
+				out += s[i];
+				continue;
+			}
+			size_t end = s.find(';', i);
+			if(end == string::npos){
+				out += s[i];
+				continue;
+			}
+			string e = s.substr(i + 1, end - i - 1);
+			if(e == "amp") out += '&';
+			else if(e == "lt") out += '<';
+			else if(e == "gt") out += '>';
+			else if(e == "quot") out += '"';
+			else if(e == "apos") out += '\'';
+			else if(e.size() > 1 && e[0] == '#'){
+				unsigned long code = e[1] == 'x' ? strtoul(e.c_str() + 2, nullptr, 16) : strtoul(e.c_str() + 1, nullptr, 10);
+				if(code < 0x80){
+					out += (char)code;
+				}else if(code < 0x800){ //utf8
+					out += (char)(0xC0 | (code >> 6));
+					out += (char)(0x80 | (code & 0x3F));
+				}else{
+					out += (char)(0xE0 | (code >> 12));
+					out += (char)(0x80 | ((code >> 6) & 0x3F));
+					out += (char)(0x80 | (code & 0x3F));
+				}
+			}else{
+				out += s.substr(i, end - i + 1); //unknown entity, leave it
+			}
+			i = end;
+		}
+		return out;
+	}
+
+	struct XmlParser{
+
+		const string & s;
+		size_t p = 0;
+
+		XmlParser(const string & src) : s(src){}
+
+		void skipSpace(){
+			while(p < s.size() && isspace((unsigned char)s[p])) p++;
+		}
+
+		bool skipMisc(){ //declarations, comments, doctype
+			skipSpace();
+			if(s.compare(p, 4, "<!--") == 0){
+				size_t end = s.find("-->", p);
+				if(end == string::npos) return false;
+				p = end + 3;
+				return true;
+			}
+			if(s.compare(p, 2, "<?") == 0 || s.compare(p, 2, "<!") == 0){
+				size_t end = s.find('>', p);
+				if(end == string::npos) return false;
+				p = end + 1;
+				return true;
+			}
+			return false;
+		}
+
+		string parseName(){
+			size_t start = p;
+			while(p < s.size() && !isspace((unsigned char)s[p]) && s[p] != '>' && s[p] != '/' && s[p] != '=') p++;
+			return s.substr(start, p - start);
+		}
+
+		bool parseElement(XmlNode & node){
+			while(skipMisc()){}
+			if(p >= s.size() || s[p] != '<') return false;
+			p++;
+			node.name = parseName();
+			if(node.name.empty()) return false;
+
+			while(true){ //attributes
+				skipSpace();
+				if(p >= s.size()) return false;
+				if(s[p] == '/'){ //self closing
+					if(s.compare(p, 2, "/>") != 0) return false;
+					p += 2;
+					return true;
+				}
+				if(s[p] == '>'){
+					p++;
+					break;
+				}
+				string attrName = parseName();
+				skipSpace();
+				if(p >= s.size() || s[p] != '=') return false;
+				p++;
+				skipSpace();
+				if(p >= s.size() || (s[p] != '"' && s[p] != '\'')) return false;
+				char quote = s[p++];
+				size_t end = s.find(quote, p);
+				if(end == string::npos) return false;
+				node.attributes[attrName] = xmlUnescape(s.substr(p, end - p));
+				p = end + 1;
+			}
+
+			while(true){ //content
+				if(s.compare(p, 4, "<!--") == 0){
+					skipMisc();
+					continue;
+				}
+				if(s.compare(p, 9, "<![CDATA[") == 0){
+					size_t end = s.find("]]>", p);
+					if(end == string::npos) return false;
+					node.text += s.substr(p + 9, end - p - 9);
+					p = end + 3;
+					continue;
+				}
+				if(s.compare(p, 2, "</") == 0){
+					size_t end = s.find('>', p);
+					if(end == string::npos) return false;
+					p = end + 1;
+					if(node.children.size()){ //ignore the indentation between children
+						node.text.clear();
+					}
+					return true;
+				}
+				if(p < s.size() && s[p] == '<'){
+					node.children.push_back(XmlNode());
+					if(!parseElement(node.children.back())) return false;
+					continue;
+				}
+				size_t end = s.find('<', p);
+				if(end == string::npos) return false;
+				node.text += xmlUnescape(s.substr(p, end - p));
+				p = end;
+			}
+		}
+	};
+}
+
+
+// JobStore ///////////////////////////////////////////////////////////////////////////////////////
+
+bool ofxUserContentUploadJobStore::setup(const string & storageDir){
+	pendingDir = (fs::path(storageDir) / "pending").string();
+	failedDir = (fs::path(storageDir) / "failed").string();
+	std::error_code err;
+	fs::create_directories(pendingDir, err);
+	fs::create_directories(failedDir, err);
+	if(!fs::is_directory(pendingDir) || !fs::is_directory(failedDir)){
+		LOG_ERROR << "can't create job dirs at '" << storageDir << "'! " << err.message();
+		return false;
+	}
+	return true;
+}
+
+
+string ofxUserContentUploadJobStore::fileNameForJob(const Job & j){
+	//files are named after the job's queueID so that sorting them matches enqueue order.
+	//"u" sorts after the "t<timestamp>" names older versions used, so those go first.
+	return "u" + j.queueID + "_" + ofxUserContentUploadTypes::getFileSystemSafeString(j.jobID) + ".job";
+}
+
+
+string ofxUserContentUploadJobStore::getPath(const string & fileName, bool failed){
+	return (fs::path(failed ? failedDir : pendingDir) / fileName).string();
+}
+
+
+void ofxUserContentUploadJobStore::list(bool failed, vector<string> & fileNames){
+	fileNames.clear();
+	std::error_code err;
+	for(fs::directory_iterator it(failed ? failedDir : pendingDir, err), end; !err && it != end; it.increment(err)){
+		if(it->path().extension() == ".job"){
+			fileNames.push_back(it->path().filename().string());
+		}
+	}
+	std::sort(fileNames.begin(), fileNames.end()); //plain lexical order, so queueIDs sort by time
+}
+
+
+bool ofxUserContentUploadJobStore::exists(const string & fileName, bool failed){
+	std::error_code err;
+	return fs::exists(getPath(fileName, failed), err);
+}
+
+
+bool ofxUserContentUploadJobStore::save(const Job & job, const string & fileName, bool failed){
+	return writeJob(job, getPath(fileName, failed));
+}
+
+
+bool ofxUserContentUploadJobStore::load(const string & fileName, bool failed, Job & job){
+	return readJob(getPath(fileName, failed), job);
+}
+
+
+void ofxUserContentUploadJobStore::remove(const string & fileName, bool failed){
+	std::error_code err;
+	fs::remove(getPath(fileName, failed), err);
+}
+
+
+bool ofxUserContentUploadJobStore::moveToFailed(const string & fileName){
+	std::error_code err;
+	fs::rename(getPath(fileName, false), getPath(fileName, true), err);
+	if(err){
+		LOG_ERROR << "can't move job '" << fileName << "' to the failed dir! " << err.message();
+	}
+	return !err;
+}
+
+
+bool ofxUserContentUploadJobStore::writeJob(const Job & j, const string & path){
+
+	std::ostringstream xml;
+	xml << "<ofxUserContentJob>\n";
+	xml << "    <config>\n";
+	xml << "        <host>" << xmlEscape(j.host) << "</host>\n";
+	xml << "        <port>" << j.port << "</port>\n";
+	xml << "        <jobID>" << xmlEscape(j.jobID) << "</jobID>\n";
+	xml << "        <queueID>" << xmlEscape(j.queueID) << "</queueID>\n";
+	xml << "        <orderingKey>" << xmlEscape(j.orderingKey) << "</orderingKey>\n";
+	xml << "        <timeStamp>" << j.timeStamp << "</timeStamp>\n";
+	xml << "        <verbose>" << (j.verbose ? 1 : 0) << "</verbose>\n";
+	xml << "        <numTries>" << j.numTries << "</numTries>\n";
+	xml << "        <expiryTime>" << j.expiryTime << "</expiryTime>\n";
+	xml << "    </config>\n";
+	xml << "    <fields>\n";
+	for(auto & f : j.formFields){
+		xml << "        <field fieldName=\"" << xmlEscape(f.first) << "\" fieldValue=\"" << xmlEscape(f.second) << "\" />\n";
+	}
+	xml << "    </fields>\n";
+	xml << "    <files>\n";
+	for(auto & f : j.fileFields){
+		xml << "        <file fileFieldName=\"" << xmlEscape(f.first) << "\" filePath=\"" << xmlEscape(f.second.first)
+			<< "\" mimeType=\"" << xmlEscape(f.second.second) << "\" />\n";
+	}
+	xml << "    </files>\n";
+	xml << "</ofxUserContentJob>\n";
+
+	//write & rename, so that no one (ie an uploader in another process) ever sees a half written job
+	string tmp = path + ".tmp";
+	{
+		std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+		out << xml.str();
+		if(!out.good()){
+			LOG_ERROR << "can't write job file '" << tmp << "'!";
+			return false;
+		}
+	}
+	std::error_code err;
+	fs::rename(tmp, path, err);
+	if(err){
+		LOG_ERROR << "can't save job file '" << path << "'! " << err.message();
+		fs::remove(tmp, err);
+		return false;
+	}
+	return true;
+}
+
+
+bool ofxUserContentUploadJobStore::readJob(const string & path, Job & job){
+
+	std::ifstream in(path, std::ios::binary);
+	if(!in){
+		LOG_ERROR << "can't open job file '" << path << "'";
+		return false;
+	}
+	std::stringstream buffer;
+	buffer << in.rdbuf();
+	string src = buffer.str();
+
+	XmlNode root;
+	XmlParser parser(src);
+	if(!parser.parseElement(root) || root.name != "ofxUserContentJob"){
+		LOG_ERROR << "can't parse job file '" << path << "'";
+		return false;
+	}
+
+	XmlNode empty;
+	const XmlNode * config = root.child("config");
+	if(!config) config = &empty;
+	job.host = config->childText("host", "");
+	job.port = config->childInt("port", 80);
+	job.jobID = config->childText("jobID", "missing JOB ID!");
+	job.timeStamp = config->childInt("timeStamp", 0); //0 - the upload thread stamps it with its clock
+	job.queueID = config->childText("queueID", "");
+	if(job.queueID.size() == 0){ //job saved by an older version - derive it from its creation time & file,
+		//so it's the same every time it's loaded, and it still sorts ahead of the jobs added after it
+		job.queueID = ofxUserContentUploadTypes::getULID((uint64_t)std::max(job.timeStamp, 0) * 1000, fs::path(path).filename().string());
+	}
+	job.orderingKey = config->childText("orderingKey", "");
+	job.verbose = config->childInt("verbose", 0) != 0;
+	job.numTries = config->childInt("numTries", 0);
+	job.expiryTime = config->childInt("expiryTime", 0);
+
+	bool parseOK = true;
+	if(job.host.size() == 0){
+		LOG_ERROR << "host not defined!";
+		parseOK = false;
+	}
+
+	if(const XmlNode * fields = root.child("fields")){
+		for(auto & f : fields->children){
+			if(f.name != "field") continue;
+			string fieldName = f.attribute("fieldName");
+			string fieldValue = f.attribute("fieldValue");
+			if(fieldName.size() == 0 ){
+				parseOK = false;
+				LOG_ERROR << "empty fieldName! " << fieldName << " - " << fieldValue;
+			}else{
+				job.formFields[fieldName] = fieldValue;
+			}
+		}
+	}
+
+	if(const XmlNode * files = root.child("files")){
+		for(auto & f : files->children){
+			if(f.name != "file") continue;
+			string fileName = f.attribute("fileFieldName");
+			string filePath = f.attribute("filePath");
+			string mimeType = f.attribute("mimeType");
+			if(fileName.size() == 0 || filePath.size() == 0 || mimeType.size() == 0){
+				parseOK = false;
+			}else{
+				job.fileFields[fileName] = std::make_pair(filePath, mimeType);
+			}
+		}
+	}
+
+	return parseOK;
+}
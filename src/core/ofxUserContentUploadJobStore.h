@@ -0,0 +1,48 @@
+//
+//  ofxUserContentUploadJobStore.h
+//  ofxUserContentUpload
+//
+//  Persists jobs as xml files in storageDir/pending and storageDir/failed, in the same
+//  format ofxXmlSettings used to write them - so job files left by older versions still load.
+//  Job files are written to a .tmp file and renamed into place, so no one (ie an uploader in
+//  another process) ever reads a half written job.
+//
+//  Subclasses can keep jobs elsewhere - see ofxUserContentUploadMemoryJobStore.
+//
+
+#pragma once
+
+#include "ofxUserContentUploadTypes.h"
+
+class ofxUserContentUploadJobStore{
+
+public:
+
+	typedef ofxUserContentUploadTypes::Job Job;
+
+	virtual ~ofxUserContentUploadJobStore(){}
+
+	virtual bool setup(const string & storageDir); //creates the pending & failed dirs if needed
+
+	static string fileNameForJob(const Job & job);
+	string getPath(const string & fileName, bool failedDir);
+
+	virtual void list(bool failedDir, vector<string> & fileNames); //sorted - oldest first
+	virtual bool exists(const string & fileName, bool failedDir);
+	virtual bool save(const Job & job, const string & fileName, bool failedDir);
+	virtual bool load(const string & fileName, bool failedDir, Job & job);
+	virtual void remove(const string & fileName, bool failedDir);
+	virtual bool moveToFailed(const string & fileName);
+
+	//can jobs be added or removed behind our back (ie by an enqueue only client)?
+	//if so, the upload thread lists the store on every run to find out.
+	virtual bool isShared(){ return true; }
+
+	static bool writeJob(const Job & job, const string & path);
+	static bool readJob(const string & path, Job & job);
+
+protected:
+
+	string pendingDir;
+	string failedDir;
+};
@@ -0,0 +1,51 @@
+//
+//  ofxUserContentUploadMemoryJobStore.cpp
+//  ofxUserContentUpload
+//
+
+#include "ofxUserContentUploadMemoryJobStore.h"
+
+
+void ofxUserContentUploadMemoryJobStore::list(bool failedDir, vector<string> & fileNames){
+	map<string, Job> & jobs = failedDir ? failed : pending;
+	fileNames.clear();
+	fileNames.reserve(jobs.size());
+	for(auto & j : jobs){
+		fileNames.push_back(j.first);
+	}
+}
+
+
+bool ofxUserContentUploadMemoryJobStore::exists(const string & fileName, bool failedDir){
+	map<string, Job> & jobs = failedDir ? failed : pending;
+	return jobs.find(fileName) != jobs.end();
+}
+
+
+bool ofxUserContentUploadMemoryJobStore::save(const Job & job, const string & fileName, bool failedDir){
+	(failedDir ? failed : pending)[fileName] = job;
+	return true;
+}
+
+
+bool ofxUserContentUploadMemoryJobStore::load(const string & fileName, bool failedDir, Job & job){
+	map<string, Job> & jobs = failedDir ? failed : pending;
+	auto it = jobs.find(fileName);
+	if(it == jobs.end()) return false;
+	job = it->second;
+	return true;
+}
+
+
+void ofxUserContentUploadMemoryJobStore::remove(const string & fileName, bool failedDir){
+	(failedDir ? failed : pending).erase(fileName);
+}
+
+
+bool ofxUserContentUploadMemoryJobStore::moveToFailed(const string & fileName){
+	auto it = pending.find(fileName);
+	if(it == pending.end()) return false;
+	failed[fileName] = std::move(it->second);
+	pending.erase(it);
+	return true;
+}
@@ -0,0 +1,37 @@
+//
+//  ofxUserContentUploadMemoryJobStore.h
+//  ofxUserContentUpload
+//
+//  Keeps the job queue in memory instead of storageDir - nothing survives a relaunch, so this
+//  is only meant for runs that don't need that, ie replaying huge workloads through the
+//  scheduler in virtual time (see example-simulator).
+//
+//  upload.setJobStore(make_shared<ofxUserContentUploadMemoryJobStore>()); //before setup()
+//  Doesn't work with enqueue only clients, as there's no one to share the queue with.
+//
+
+#pragma once
+
+#include "ofxUserContentUploadJobStore.h"
+
+class ofxUserContentUploadMemoryJobStore : public ofxUserContentUploadJobStore{
+
+public:
+
+	bool setup(const string & storageDir){ return true; }
+
+	void list(bool failedDir, vector<string> & fileNames);
+	bool exists(const string & fileName, bool failedDir);
+	bool save(const Job & job, const string & fileName, bool failedDir);
+	bool load(const string & fileName, bool failedDir, Job & job);
+	void remove(const string & fileName, bool failedDir);
+	bool moveToFailed(const string & fileName);
+
+	bool isShared(){ return false; }
+
+protected:
+
+	//only touched from the upload thread - there's no one else to share it with
+	map<string, Job> pending; //sorted by name, like the job files on disk
+	map<string, Job> failed;
+};
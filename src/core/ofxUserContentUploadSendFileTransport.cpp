@@ -0,0 +1,400 @@
+//
+//  ofxUserContentUploadSendFileTransport.cpp
+//  ofxUserContentUpload
+//
+
+#include "ofxUserContentUploadSendFileTransport.h"
+#include "ofxUserContentUploadCurlTransport.h"
+#include <chrono>
+#include <atomic>
+#include <algorithm>
+#include <cctype>
+
+#ifdef __linux__
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <netdb.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <signal.h>
+#include <pthread.h>
+#include <errno.h>
+#include <string.h>
+#endif
+
+
+static string toLower(string s){
+	std::transform(s.begin(), s.end(), s.begin(), [](unsigned char c){ return std::tolower(c); });
+	return s;
+}
+
+
+ofxUserContentUploadSendFileTransport::ofxUserContentUploadSendFileTransport(){
+	fallback = make_shared<ofxUserContentUploadCurlTransport>(ofxUserContentUploadCurlTransport::HTTP_2, 1);
+}
+
+
+ofxUserContentUploadTypes::TransportResponse ofxUserContentUploadSendFileTransport::submitJob(const Job & job, float connectTimeOut, float timeOut){
+#ifdef __linux__
+	Url u;
+	if(parseUrl(job.host, job.port, u) && u.scheme == "http"){
+		return submitJobZeroCopy(job, u, connectTimeOut, timeOut);
+	}
+#endif
+	if(fallback){ //https or unsupported platform - buffered path
+		return fallback->submitJob(job, connectTimeOut, timeOut);
+	}
+	TransportResponse r;
+	r.url = job.host;
+	r.reasonForStatus = "no fallback transport for this url";
+	return r;
+}
+
+
+void ofxUserContentUploadSendFileTransport::cancelJobs(){
+	Transport::cancelJobs();
+	if(fallback) fallback->cancelJobs();
+}
+
+
+bool ofxUserContentUploadSendFileTransport::isZeroCopyAvailable(const Job & job){
+#ifdef __linux__
+	Url u;
+	return parseUrl(job.host, job.port, u) && u.scheme == "http";
+#else
+	return false;
+#endif
+}
+
+
+bool ofxUserContentUploadSendFileTransport::parseUrl(const string & url, int defaultPort, Url & u){
+
+	string rest = url;
+	size_t schemeEnd = rest.find("://");
+	if(schemeEnd != string::npos){
+		u.scheme = toLower(rest.substr(0, schemeEnd));
+		rest = rest.substr(schemeEnd + 3);
+	}else{
+		u.scheme = "http";
+	}
+
+	size_t pathStart = rest.find('/');
+	string hostPort = rest.substr(0, pathStart);
+	u.path = pathStart == string::npos ? "/" : rest.substr(pathStart);
+	u.port = defaultPort;
+
+	size_t portStart = string::npos;
+	if(hostPort.size() && hostPort[0] == '['){ //ipv6 literal
+		size_t end = hostPort.find(']');
+		if(end == string::npos) return false;
+		u.host = hostPort.substr(1, end - 1);
+		if(end + 1 < hostPort.size() && hostPort[end + 1] == ':') portStart = end + 2;
+	}else{
+		size_t colon = hostPort.find(':');
+		u.host = hostPort.substr(0, colon);
+		if(colon != string::npos) portStart = colon + 1;
+	}
+	if(portStart != string::npos){
+		u.port = atoi(hostPort.substr(portStart).c_str());
+	}
+	return u.host.size() > 0 && u.port > 0 && u.port < 65536;
+}
+
+
+#ifdef __linux__
+
+namespace{
+
+	//we give up at time, or once the transport's cancelCount moves on from what it was when we started
+	struct Deadline{
+		std::chrono::steady_clock::time_point time;
+		const std::atomic<unsigned int> * cancelCount;
+		unsigned int startCancelCount;
+		bool cancelled() const { return *cancelCount != startCancelCount; }
+	};
+
+	int millisLeft(const Deadline & deadline){
+		if(deadline.cancelled()) return 0;
+		auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline.time - std::chrono::steady_clock::now()).count();
+		return left > 0 ? (int)left : 0;
+	}
+
+	bool waitForSocket(int fd, short events, const Deadline & deadline){
+		while(true){
+			int ms = millisLeft(deadline);
+			if(ms == 0) return false;
+			struct pollfd p = {fd, events, 0};
+			int ret = poll(&p, 1, std::min(ms, 100)); //short slices, to notice cancelJobs()
+			if(ret > 0) return true;
+			if(ret < 0 && errno != EINTR) return false;
+		}
+	}
+
+	//sendfile() raises SIGPIPE if the server drops the connection; block it on this thread only
+	//while we write (and swallow it if it fired) rather than touching the app's signal handlers.
+	struct ScopedSigPipeBlock{
+		sigset_t pipeSet;
+		sigset_t oldSet;
+		ScopedSigPipeBlock(){
+			sigemptyset(&pipeSet);
+			sigaddset(&pipeSet, SIGPIPE);
+			pthread_sigmask(SIG_BLOCK, &pipeSet, &oldSet);
+		}
+		~ScopedSigPipeBlock(){
+			struct timespec zero = {0, 0};
+			while(sigtimedwait(&pipeSet, nullptr, &zero) > 0){}
+			pthread_sigmask(SIG_SETMASK, &oldSet, nullptr);
+		}
+	};
+
+	//these return 0 or the errno of what went wrong (ETIMEDOUT if we ran out of time) - errno
+	//itself doesn't survive until the caller looks at it (ie ~ScopedSigPipeBlock() clobbers it)
+	int sendAll(int sock, const string & data, bool more, const Deadline & deadline){
+		size_t sent = 0;
+		while(sent < data.size()){
+			ssize_t n = send(sock, data.data() + sent, data.size() - sent, MSG_NOSIGNAL | (more ? MSG_MORE : 0));
+			if(n > 0){
+				sent += n;
+			}else if(n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)){
+				if(!waitForSocket(sock, POLLOUT, deadline)) return ETIMEDOUT;
+			}else{
+				return n < 0 ? errno : EPIPE;
+			}
+		}
+		return 0;
+	}
+
+	int sendFileAll(int sock, int fd, off_t size, const Deadline & deadline){
+		off_t offset = 0;
+		while(offset < size){
+			size_t chunk = (size_t)std::min(size - offset, (off_t)1 << 30);
+			ssize_t n = sendfile(sock, fd, &offset, chunk);
+			if(n > 0){
+				continue; //offset already moved forward
+			}else if(n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)){
+				if(!waitForSocket(sock, POLLOUT, deadline)) return ETIMEDOUT;
+			}else{
+				return n < 0 ? errno : EIO; //n == 0 means the file shrunk under us
+			}
+		}
+		return 0;
+	}
+
+	int connectTo(const string & host, int port, const Deadline & deadline, string & error){
+
+		struct addrinfo hints;
+		memset(&hints, 0, sizeof(hints));
+		hints.ai_family = AF_UNSPEC;
+		hints.ai_socktype = SOCK_STREAM;
+		struct addrinfo * addrs = nullptr;
+		int ret = getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &addrs);
+		if(ret != 0){
+			error = string("can't resolve host: ") + gai_strerror(ret);
+			return -1;
+		}
+
+		int sock = -1;
+		for(struct addrinfo * a = addrs; a != nullptr && sock < 0; a = a->ai_next){
+			sock = socket(a->ai_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+			if(sock < 0) continue;
+			if(connect(sock, a->ai_addr, a->ai_addrlen) != 0){
+				int err = errno;
+				if(err == EINPROGRESS && waitForSocket(sock, POLLOUT, deadline)){
+					socklen_t len = sizeof(err);
+					getsockopt(sock, SOL_SOCKET, SO_ERROR, &err, &len);
+				}else if(err == EINPROGRESS){
+					err = ETIMEDOUT;
+				}
+				if(err != 0){
+					error = string("can't connect: ") + strerror(err);
+					close(sock);
+					sock = -1;
+				}
+			}
+		}
+		freeaddrinfo(addrs);
+		return sock;
+	}
+
+	string dechunk(const string & body){
+		string out;
+		size_t pos = 0;
+		while(pos < body.size()){
+			size_t lineEnd = body.find("\r\n", pos);
+			if(lineEnd == string::npos) break;
+			size_t len = strtoul(body.substr(pos, lineEnd - pos).c_str(), nullptr, 16);
+			if(len == 0) break;
+			out += body.substr(lineEnd + 2, len);
+			pos = lineEnd + 2 + len + 2;
+		}
+		return out;
+	}
+
+	string partHeader(const string & boundary, const string & fieldName, const string & fileName, const string & mimeType){
+		string h = "--" + boundary + "\r\nContent-Disposition: form-data; name=\"" + fieldName + "\"";
+		if(fileName.size()){
+			h += "; filename=\"" + fileName + "\"\r\nContent-Type: " + mimeType;
+		}
+		return h + "\r\n\r\n";
+	}
+}
+
+
+ofxUserContentUploadTypes::TransportResponse ofxUserContentUploadSendFileTransport::submitJobZeroCopy(const Job & job,
+																		  const Url & url,
+																		  float connectTimeOut,
+																		  float timeOut){
+	auto start = std::chrono::steady_clock::now();
+	Deadline deadline = {start + std::chrono::milliseconds((long long)(timeOut * 1000)), &cancelCount, cancelCount};
+	Deadline connectDeadline = deadline;
+	connectDeadline.time = std::min(deadline.time, start + std::chrono::milliseconds((long long)(connectTimeOut * 1000)));
+
+	TransportResponse r;
+	r.url = job.host;
+
+	struct Attachment{
+		int fd;
+		off_t size;
+	};
+	vector<Attachment> files;
+	vector<string> fileHeaders;
+
+	auto finish = [&](const string & error) -> TransportResponse{
+		for(auto & f : files) close(f.fd);
+		if(error.size()) r.reasonForStatus = deadline.cancelled() ? "cancelled" : error;
+		r.totalTime = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count() / 1000000.0f;
+		return r;
+	};
+
+	string boundary = ofxUserContentUploadTypes::getNewUUID();
+	boundary = "ofxUserContentUpload" + string(boundary.begin(), std::remove(boundary.begin(), boundary.end(), '-'));
+
+	string fields;
+	for(auto & ff : job.formFields){
+		fields += partHeader(boundary, ff.first, "", "") + ff.second + "\r\n";
+	}
+
+	uint64_t contentLength = fields.size();
+	for(auto & ff : job.fileFields){
+		int fd = open(ff.second.first.c_str(), O_RDONLY | O_CLOEXEC);
+		struct stat st;
+		if(fd < 0 || fstat(fd, &st) != 0){
+			if(fd >= 0) close(fd);
+			return finish("can't open file to upload: '" + ff.second.first + "'");
+		}
+		files.push_back({fd, st.st_size});
+		string fileName = ff.second.first.substr(ff.second.first.find_last_of("/\\") + 1);
+		for(size_t q = fileName.find('"'); q != string::npos; q = fileName.find('"', q)){
+			fileName.replace(q, 1, "%22");
+		}
+		fileHeaders.push_back(partHeader(boundary, ff.first, fileName, ff.second.second));
+		contentLength += fileHeaders.back().size() + st.st_size + 2; //+ "\r\n" after the file
+		posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+	}
+	string closing = "--" + boundary + "--\r\n";
+	contentLength += closing.size();
+
+	string request = "POST " + url.path + " HTTP/1.1\r\n"
+		"Host: " + url.host + (url.port != 80 ? ":" + std::to_string(url.port) : "") + "\r\n"
+		"User-Agent: ofxUserContentUpload\r\n"
+		"Accept: */*\r\n"
+		"Connection: close\r\n"
+		"Content-Type: multipart/form-data; boundary=" + boundary + "\r\n"
+		"Content-Length: " + std::to_string(contentLength) + "\r\n\r\n" + fields;
+
+	string error;
+	int sock = connectTo(url.host, url.port, connectDeadline, error);
+	if(sock < 0){
+		return finish(error);
+	}
+
+	int sendError = 0;
+	{
+		ScopedSigPipeBlock noSigPipe;
+		//small buffers for headers & boundaries, file bodies straight from the page cache
+		string pending = request;
+		for(size_t i = 0; i < files.size() && !sendError; i++){
+			pending += fileHeaders[i];
+			sendError = sendAll(sock, pending, true, deadline);
+			if(!sendError) sendError = sendFileAll(sock, files[i].fd, files[i].size, deadline);
+			pending = "\r\n";
+		}
+		if(!sendError) sendError = sendAll(sock, pending + closing, false, deadline);
+	}
+	if(sendError){
+		close(sock);
+		return finish(sendError == ETIMEDOUT ? "Timeout sending request" : string("error sending request: ") + strerror(sendError));
+	}
+
+	//read the response; we asked the server to close the connection when done
+	string response;
+	size_t headerEnd = string::npos;
+	long long bodyLength = -1;
+	bool chunked = false;
+	bool gotAll = false;
+	int readError = 0;
+	char buffer[16 * 1024];
+	while(!gotAll){
+		ssize_t n = recv(sock, buffer, sizeof(buffer), 0);
+		if(n > 0){
+			response.append(buffer, n);
+			if(headerEnd == string::npos){
+				headerEnd = response.find("\r\n\r\n");
+				if(headerEnd != string::npos){
+					string headers = toLower(response.substr(0, headerEnd));
+					size_t cl = headers.find("\r\ncontent-length:");
+					if(cl != string::npos) bodyLength = strtoll(headers.c_str() + cl + 17, nullptr, 10);
+					chunked = headers.find("\r\ntransfer-encoding: chunked") != string::npos;
+				}
+			}
+			if(headerEnd != string::npos){
+				if(!chunked && bodyLength >= 0){
+					gotAll = (long long)(response.size() - headerEnd - 4) >= bodyLength;
+				}else if(chunked){
+					gotAll = response.find("\r\n0\r\n\r\n", headerEnd) != string::npos;
+				}
+			}
+		}else if(n == 0){ //server closed the connection - that ends the body only if it had no length
+			gotAll = headerEnd != string::npos && !chunked && bodyLength < 0;
+			if(!gotAll) readError = ECONNRESET;
+			break;
+		}else if(errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR){
+			if(!waitForSocket(sock, POLLIN, deadline)) break;
+		}else{
+			readError = errno;
+			break;
+		}
+	}
+	close(sock);
+
+	if(!gotAll){ //don't report a truncated response as a success
+		if(readError) return finish(string("error reading response: ") + (readError == ECONNRESET ? "connection closed early" : strerror(readError)));
+		return finish(headerEnd == string::npos ? "Timeout waiting for response" : "Timeout reading response");
+	}
+	if(headerEnd == string::npos){
+		return finish("invalid http response");
+	}
+
+	//"HTTP/1.1 200 OK"
+	size_t lineEnd = response.find("\r\n");
+	string statusLine = response.substr(0, lineEnd);
+	size_t codeStart = statusLine.find(' ');
+	if(statusLine.find("HTTP/") != 0 || codeStart == string::npos){
+		return finish("invalid http status line");
+	}
+	r.status = atoi(statusLine.c_str() + codeStart + 1);
+	size_t reasonStart = statusLine.find(' ', codeStart + 1);
+	r.reasonForStatus = reasonStart == string::npos ? "" : statusLine.substr(reasonStart + 1);
+
+	r.responseBody = response.substr(headerEnd + 4);
+	if(chunked){
+		r.responseBody = dechunk(r.responseBody);
+	}else if(bodyLength >= 0 && (long long)r.responseBody.size() > bodyLength){
+		r.responseBody.resize(bodyLength);
+	}
+	return finish("");
+}
+
+#endif
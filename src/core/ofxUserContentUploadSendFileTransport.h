@@ -0,0 +1,50 @@
+//
+//  ofxUserContentUploadSendFileTransport.h
+//  ofxUserContentUpload
+//
+//  Zero-copy transport for plain http uploads on Linux. The multipart headers & boundaries
+//  are written from small buffers, and file attachments are sent straight from the page
+//  cache to the socket with sendfile(), never copied through user space.
+//
+//  https urls (and any non-Linux platform) go through the fallback transport, by default an
+//  ofxUserContentUploadCurlTransport (one job at a time); setFallback() to use another one.
+//
+//  upload.setTransport(make_shared<ofxUserContentUploadSendFileTransport>());
+//
+
+#pragma once
+
+#include "ofxUserContentUploadTypes.h"
+
+class ofxUserContentUploadSendFileTransport : public ofxUserContentUploadTypes::Transport{
+
+public:
+
+	typedef ofxUserContentUploadTypes::Job Job;
+	typedef ofxUserContentUploadTypes::TransportResponse TransportResponse;
+
+	ofxUserContentUploadSendFileTransport();
+
+	TransportResponse submitJob(const Job & job, float connectTimeOut, float timeOut);
+
+	bool isZeroCopyAvailable(const Job & job); //false if we will fall back
+
+	void setFallback(shared_ptr<ofxUserContentUploadTypes::Transport> t){ fallback = t; }
+
+	void cancelJobs(); //the fallback's too
+
+protected:
+
+	struct Url{
+		string scheme;
+		string host;
+		int port;
+		string path;
+	};
+
+	static bool parseUrl(const string & url, int defaultPort, Url & result);
+
+	TransportResponse submitJobZeroCopy(const Job & job, const Url & url, float connectTimeOut, float timeOut);
+
+	shared_ptr<ofxUserContentUploadTypes::Transport> fallback;
+};
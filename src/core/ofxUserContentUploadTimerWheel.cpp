@@ -0,0 +1,82 @@
+//
+//  ofxUserContentUploadTimerWheel.cpp
+//  ofxUserContentUpload
+//
+
+#include "ofxUserContentUploadTimerWheel.h"
+
+
+ofxUserContentUploadTimerWheel::ofxUserContentUploadTimerWheel(){
+}
+
+
+void ofxUserContentUploadTimerWheel::start(uint64_t now){
+	current = now;
+}
+
+
+void ofxUserContentUploadTimerWheel::add(uint64_t expiryTime, const std::string & key){
+	numTimers++;
+	place({expiryTime, key});
+}
+
+
+void ofxUserContentUploadTimerWheel::place(const Timer & t){
+
+	if(t.expiryTime <= current){
+		due.push_back(t);
+		return;
+	}
+
+	uint64_t delta = t.expiryTime - current;
+	for(int level = 0; level < numLevels; level++){
+		if(delta < (uint64_t(1) << (slotBits * (level + 1)))){
+			slots[level][(t.expiryTime >> (slotBits * level)) & (numSlots - 1)].push_back(t);
+			return;
+		}
+	}
+
+	//too far away - park it in the last top level slot we'll reach, it will be re-placed from there
+	int top = numLevels - 1;
+	uint64_t horizon = current + (uint64_t(1) << (slotBits * numLevels)) - 1;
+	slots[top][(horizon >> (slotBits * top)) & (numSlots - 1)].push_back(t);
+}
+
+
+void ofxUserContentUploadTimerWheel::cascade(int level){
+	std::vector<Timer> timers;
+	timers.swap(slots[level][(current >> (slotBits * level)) & (numSlots - 1)]);
+	for(auto & t : timers){
+		place(t); //lands in a lower level (or in due)
+	}
+}
+
+
+void ofxUserContentUploadTimerWheel::advance(uint64_t now, std::vector<std::string> & expired){
+
+	while(current < now){
+		current++;
+
+		//on each level wrap, spread the next higher level slot over the lower levels - top down
+		int numCascade = 0;
+		while(numCascade < numLevels - 1 && (current & ((uint64_t(1) << (slotBits * (numCascade + 1))) - 1)) == 0){
+			numCascade++;
+		}
+		for(int level = numCascade; level > 0; level--){
+			cascade(level);
+		}
+
+		std::vector<Timer> & slot = slots[0][current & (numSlots - 1)];
+		for(auto & t : slot){
+			expired.push_back(t.key);
+		}
+		numTimers -= slot.size();
+		slot.clear();
+	}
+
+	for(auto & t : due){
+		expired.push_back(t.key);
+	}
+	numTimers -= due.size();
+	due.clear();
+}
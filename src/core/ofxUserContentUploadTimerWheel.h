@@ -0,0 +1,46 @@
+//
+//  ofxUserContentUploadTimerWheel.h
+//  ofxUserContentUpload
+//
+//  Hierarchical timer wheel with a 1 second tick - 4 levels of 64 slots cover ~194 days,
+//  anything further away waits in the top level and gets re-placed as time goes by.
+//  Adding a timer and advancing one tick are O(1); timers can't be cancelled, the owner
+//  is expected to ignore the ones that fire for things that are already gone.
+//
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+class ofxUserContentUploadTimerWheel{
+
+public:
+
+	ofxUserContentUploadTimerWheel();
+
+	void start(uint64_t now); //unix time in seconds
+	void add(uint64_t expiryTime, const std::string & key);
+	void advance(uint64_t now, std::vector<std::string> & expired); //appends the keys that are due
+	size_t size(){ return numTimers; }
+
+protected:
+
+	static const int numLevels = 4;
+	static const int slotBits = 6;
+	static const int numSlots = 1 << slotBits;
+
+	struct Timer{
+		uint64_t expiryTime;
+		std::string key;
+	};
+
+	void place(const Timer & t);
+	void cascade(int level);
+
+	std::vector<Timer> slots[numLevels][numSlots];
+	std::vector<Timer> due; //added with an expiry time that already passed
+	uint64_t current = 0; //last tick processed
+	size_t numTimers = 0;
+};
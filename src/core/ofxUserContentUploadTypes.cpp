@@ -0,0 +1,230 @@
+//
+//  ofxUserContentUploadTypes.cpp
+//  ofxUserContentUpload
+//
+
+#include "ofxUserContentUploadTypes.h"
+#include <iostream>
+#include <algorithm>
+#include <random>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <atomic>
+
+
+// Log ////////////////////////////////////////////////////////////////////////////////////////////
+
+static std::mutex logMutex;
+static ofxUserContentUploadLog::Handler logHandler;
+static std::atomic<bool> hasLogHandler(false);
+static std::atomic<int> logLevel(ofxUserContentUploadLog::LEVEL_NOTICE);
+
+
+ofxUserContentUploadLog::ofxUserContentUploadLog(Level level, const string & module){
+	this->level = level;
+	enabled = hasLogHandler || (level >= logLevel && level != LEVEL_SILENT);
+	if(enabled) this->module = module;
+}
+
+
+ofxUserContentUploadLog::~ofxUserContentUploadLog(){
+
+	if(!enabled) return;
+	std::lock_guard<std::mutex> lock(logMutex);
+	if(logHandler){
+		logHandler(level, module, message.str());
+		return;
+	}
+	if(level < logLevel || level == LEVEL_SILENT) return;
+	static const char * names[] = {"verbose", "notice ", "warning", "error  "};
+	std::ostream & out = level >= LEVEL_WARNING ? std::cerr : std::cout;
+	out << "[" << names[level] << "] " << module << ": " << message.str() << std::endl;
+}
+
+
+void ofxUserContentUploadLog::setHandler(Handler h){
+	std::lock_guard<std::mutex> lock(logMutex);
+	logHandler = h;
+	hasLogHandler = (bool)h;
+}
+
+
+void ofxUserContentUploadLog::setLevel(Level minLevel){
+	logLevel = minLevel;
+}
+
+
+// Transport //////////////////////////////////////////////////////////////////////////////////////
+
+void ofxUserContentUploadTypes::Transport::runJobs(float maxWait, vector<JobSubmission*> & finished){
+	if(startedJobs.empty()) return;
+	vector<JobSubmission> jobs;
+	for(auto s : startedJobs) jobs.push_back(*s);
+	submitJobs(jobs);
+	for(size_t i = 0; i < jobs.size(); i++){
+		startedJobs[i]->response = jobs[i].response;
+		finished.push_back(startedJobs[i]);
+	}
+	startedJobs.clear();
+}
+
+
+// Job ////////////////////////////////////////////////////////////////////////////////////////////
+
+void ofxUserContentUploadTypes::Job::addFile(const string & fileName, const string & filePath, string mimeType){
+	if(fileFields.find(fileName) == fileFields.end()){
+		fileFields[fileName] = std::make_pair(filePath, mimeType);
+	}else{
+		ofxUserContentUploadLog(ofxUserContentUploadLog::LEVEL_ERROR, "ofxUserContentUpload::Job") << "cant addFile(), already exists! " << fileName;
+	}
+}
+
+
+void ofxUserContentUploadTypes::Job::addStringField(const string & filedName, const string & fieldValue){
+	if(formFields.find(filedName) == formFields.end()){
+		formFields[filedName] = fieldValue;
+	}else{
+		ofxUserContentUploadLog(ofxUserContentUploadLog::LEVEL_ERROR, "ofxUserContentUpload::Job") << "cant addStringField(), already exists! " << filedName;
+	}
+}
+
+
+// SystemClock ////////////////////////////////////////////////////////////////////////////////////
+
+double ofxUserContentUploadTypes::SystemClock::getUnixTime(){
+	return std::chrono::duration_cast<std::chrono::microseconds>(
+			std::chrono::system_clock::now().time_since_epoch()).count() / 1000000.0;
+}
+
+
+void ofxUserContentUploadTypes::SystemClock::sleepMillis(int ms){
+	std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+
+// Helpers ////////////////////////////////////////////////////////////////////////////////////////
+
+ofxUserContentUploadTypes::FailedJobPolicy ofxUserContentUploadTypes::getDefaultRetryPolicy() {
+	FailedJobPolicy defaultPolicy;
+	//default policy is FALSE (keep the job and retry it again later!)
+	//so define any positive status codes as TRUE - when those happen we assume the job went through ok
+	//and can be deleted.
+	// to be clear TRUE means the job needs to be retried late
+	// FALSE meanse the job is not to be retried - bc its done or bc its our fault and we cant fix it.
+	defaultPolicy[200] = false; //HTTP_OK - job done - all ok - no need to rety!
+	defaultPolicy[400] = true; //HTTP_BAD_REQUEST - if its our fault - dont try again - would fail every time anyway
+	defaultPolicy[401] = true; //HTTP_UNAUTHORIZED - will always fail
+	defaultPolicy[403] = true; //HTTP_FORBIDDEN - will always fail
+	defaultPolicy[410] = true; //HTTP_GONE - will always fail
+	return defaultPolicy;
+}
+
+
+string ofxUserContentUploadTypes::getUniqueFilename(const string & prefix){
+	string fn = prefix + "_" + std::to_string(time(nullptr)) + "_" + getNewUUID();
+	return fn;
+}
+
+
+//each thread gets its own generator, so ID generation is thread safe without locking
+static uint64_t threadRandom64(){
+	static thread_local std::mt19937_64 rng([](){
+		std::random_device rd;
+		uint64_t seed = ((uint64_t)rd() << 32) ^ rd();
+		seed ^= std::hash<std::thread::id>()(std::this_thread::get_id());
+		seed ^= (uint64_t)std::chrono::high_resolution_clock::now().time_since_epoch().count();
+		return seed;
+	}());
+	return rng();
+}
+
+
+string ofxUserContentUploadTypes::getNewUUID(){
+	static const char alphabet[] = "0123456789abcdef";
+	uint64_t hi = threadRandom64();
+	uint64_t lo = threadRandom64();
+	hi = (hi & 0xFFFFFFFFFFFF0FFFULL) | 0x0000000000004000ULL; //version 4
+	lo = (lo & 0x3FFFFFFFFFFFFFFFULL) | 0x8000000000000000ULL; //variant 10xx
+
+	char s[37];
+	int c = 0;
+	for(int i = 0; i < 32; i++){
+		if(i == 8 || i == 12 || i == 16 || i == 20) s[c++] = '-';
+		uint64_t w = i < 16 ? hi : lo;
+		s[c++] = alphabet[(w >> (4 * (15 - i % 16))) & 0xF];
+	}
+	s[c] = 0;
+	return string(s);
+}
+
+
+static string encodeULID(uint64_t time, uint64_t randHi, uint64_t randLo){
+	static const char alphabet[] = "0123456789ABCDEFGHJKMNPQRSTVWXYZ";
+	char s[27];
+	for(int i = 9; i >= 0; i--){
+		s[i] = alphabet[time & 0x1F];
+		time >>= 5;
+	}
+	for(int i = 25; i >= 10; i--){ //80 bits, low 64 first
+		s[i] = alphabet[randLo & 0x1F];
+		randLo = (randLo >> 5) | ((randHi & 0x1F) << 59);
+		randHi >>= 5;
+	}
+	s[26] = 0;
+	return string(s);
+}
+
+
+string ofxUserContentUploadTypes::getNewULID(){
+
+	//48 bits of unix time in ms + 80 random bits, crockford base32 encoded.
+	//IDs created within the same ms increment the random part of the previous one,
+	//so lexical order matches creation order across all threads.
+	static std::mutex mutex;
+	static uint64_t lastTime = 0;
+	static uint64_t lastRandHi = 0; //16 bits
+	static uint64_t lastRandLo = 0; //64 bits
+
+	uint64_t now = std::chrono::duration_cast<std::chrono::milliseconds>(
+					std::chrono::system_clock::now().time_since_epoch()).count();
+	uint64_t newRand = threadRandom64();
+	uint64_t time, randHi, randLo;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if(now > lastTime){
+			lastTime = now;
+			lastRandHi = newRand & 0x7FFF; //leave headroom so incrementing rarely overflows
+			lastRandLo = threadRandom64();
+		}else{ //same ms (or clock went back) - increment the previous one
+			lastRandLo++;
+			if(lastRandLo == 0){
+				lastRandHi = (lastRandHi + 1) & 0xFFFF;
+				if(lastRandHi == 0) lastTime++; //80 bits exhausted, borrow the next ms
+			}
+		}
+		time = lastTime; randHi = lastRandHi; randLo = lastRandLo;
+	}
+	return encodeULID(time, randHi, randLo);
+}
+
+
+string ofxUserContentUploadTypes::getULID(uint64_t unixTimeMs, const string & seed){
+	uint64_t hash = 14695981039346656037ULL; //FNV-1a
+	for(unsigned char c : seed){
+		hash = (hash ^ c) * 1099511628211ULL;
+	}
+	return encodeULID(unixTimeMs, (hash >> 48) ^ seed.size(), hash);
+}
+
+
+string ofxUserContentUploadTypes::getFileSystemSafeString(const string & input){
+	static char invalidChars[] = {'?', '\\', '/', '*', '<', '>', '"', ';', ':', '#' };
+	int howMany = sizeof(invalidChars) / sizeof(invalidChars[0]);
+	char replacementChar = '_';
+	string output = input;
+	for(int i = 0; i < howMany; i++){
+		std::replace( output.begin(), output.end(), invalidChars[i], replacementChar);
+	}
+	return output;
+}
@@ -0,0 +1,195 @@
+//
+//  ofxUserContentUploadTypes.h
+//  ofxUserContentUpload
+//
+//  Jobs, results, transport & clock interfaces and logging shared by the upload engine
+//  (ofxUserContentUploadCore), the openFrameworks addon and the headless daemon.
+//  No openFrameworks in here - plain C++17.
+//
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <functional>
+#include <atomic>
+#include <ctime>
+
+using std::string;
+using std::vector;
+using std::map;
+using std::shared_ptr;
+using std::make_shared;
+
+
+//ofLog-like stream logger; the openFrameworks addon routes it to ofLog, standalone it goes to stdout/stderr
+class ofxUserContentUploadLog{
+
+public:
+
+	enum Level{
+		LEVEL_VERBOSE,
+		LEVEL_NOTICE,
+		LEVEL_WARNING,
+		LEVEL_ERROR,
+		LEVEL_SILENT
+	};
+
+	typedef std::function<void(Level level, const string & module, const string & message)> Handler;
+
+	ofxUserContentUploadLog(Level level, const string & module);
+	~ofxUserContentUploadLog();
+
+	template<class T> ofxUserContentUploadLog & operator<<(const T & value){
+		if(enabled) message << value; //don't pay for formatting what no one will see
+		return *this;
+	}
+
+	static void setHandler(Handler h); //null restores the default (stdout/stderr)
+	static void setLevel(Level minLevel); //only used by the default handler
+
+protected:
+
+	Level level;
+	bool enabled;
+	string module;
+	std::ostringstream message;
+};
+
+
+struct ofxUserContentUploadTypes{
+
+	struct Job{
+
+		void createJob(const string & host, int port, string jobID = ""){
+			this->host = host;
+			this->port = port;
+			this->jobID = jobID;
+		}
+
+		void addFile(const string & fileName, const string & filePath, string mimeType = "text/plain");
+		void addStringField(const string & filedName, const string & fieldValue);
+
+		void expireAfter(int seconds){ //drop the job if it hasn't been sent N seconds after addJob()
+			timeToLive = seconds;
+		}
+
+		string host;
+		int port = 80;
+		string jobID; //you will get this ID back when the job is done
+		string queueID; //set by addJob() - time sortable (ULID), names the job file on disk
+		string orderingKey; //optional - jobs with the same key run strictly in the order they were added,
+							//if one fails the rest of that key waits until it succeeds. If it's dropped or expires
+							//instead, the rest of that key is dropped with it (reported as JOB_FAILED_DROPPED)
+
+		map<string, string>						formFields; //fieldName-value
+		map<string, std::pair<string, string>>	fileFields; //filedName : <filepath, mimetype> (ie "text/plain")
+
+		int timeStamp = 0; //creation (unix) time - addJob() sets it from the upload clock if 0
+		bool verbose = false;
+		int numTries = 0;
+		int timeToLive = 0; //seconds, see expireAfter() - addJob() turns it into expiryTime
+		int expiryTime = 0; //unix time, 0 means it never expires
+	};
+
+	//what a Transport got back from the server
+	struct TransportResponse{
+		int status = -1; //http status code, -1 if we never got one (ie couldn't connect, timed out)
+		string reasonForStatus; //http reason phrase, or what went wrong
+		string responseBody;
+		string url;
+		float totalTime = 0; //seconds
+	};
+
+	//one job handed to a Transport - by submitJobs() or startJob()
+	struct JobSubmission{
+		const Job * job;
+		float connectTimeOut;
+		float timeOut;
+		TransportResponse response; //filled in by the transport
+	};
+
+	//The upload thread hands the actual submission of jobs to a Transport. The openFrameworks addon
+	//defaults to HttpFormTransport (ofxHttpForm); ofxUserContentUploadSendFileTransport and
+	//ofxUserContentUploadCurlTransport (HTTP/2) work anywhere. Other backends can be plugged in
+	//with setTransport(). connectTimeOut bounds connecting to the host, timeOut the whole job;
+	//transports that can't time out the connection on its own (ie HttpFormTransport) ignore
+	//connectTimeOut.
+	//Transports that can run several jobs at once (ie as HTTP/2 streams over one connection)
+	//return more than 1 from getMaxConcurrentJobs(). The upload thread keeps up to that many jobs
+	//in flight: it hands each one over with startJob() as soon as there's room, and calls runJobs()
+	//to move them along & collect the finished ones - so one slow job never holds back the rest.
+	//Transports that can't run jobs in the background only need submitJob() (and maybe
+	//submitJobs()): by default, runJobs() runs the started jobs through submitJobs() right away.
+	//All calls come from the upload thread, but cancelJobs().
+	struct Transport{
+		virtual ~Transport(){}
+		virtual TransportResponse submitJob(const Job & job, float connectTimeOut, float timeOut) = 0;
+		virtual int getMaxConcurrentJobs(){ return 1; }
+		virtual void submitJobs(vector<JobSubmission> & jobs){ //returns once all are done
+			for(auto & s : jobs){
+				s.response = submitJob(*s.job, s.connectTimeOut, s.timeOut);
+			}
+		}
+		//the submission (and its job) stay valid until runJobs() hands it back, or abortJobs()
+		virtual void startJob(JobSubmission * submission){ startedJobs.push_back(submission); }
+		//waits up to maxWait seconds for jobs to finish - returns as soon as any did
+		virtual void runJobs(float maxWait, vector<JobSubmission*> & finished);
+		virtual void abortJobs(){ startedJobs.clear(); } //forget all the jobs in flight - ie when stopping
+		//called from any thread (ie by stop()) to make the jobs in flight give up as soon as they can -
+		//they come back with status -1. Jobs started after the call are not affected.
+		virtual void cancelJobs(){ cancelCount++; }
+	protected:
+		vector<JobSubmission*> startedJobs;
+		std::atomic<unsigned int> cancelCount{0}; //jobs started while it had another value were cancelled
+	};
+
+	//Time source for the upload thread. SystemClock (default) really sleeps; a virtual clock
+	//lets the real scheduling & retry logic run in simulated time (see example-simulator).
+	struct Clock{
+		virtual ~Clock(){}
+		virtual double getUnixTime() = 0; //seconds
+		virtual void sleepMillis(int ms) = 0;
+		virtual bool isVirtual(){ return false; } //true if sleeping costs no real time
+	};
+
+	struct SystemClock : public Clock{
+		double getUnixTime();
+		void sleepMillis(int ms);
+	};
+
+	//http status code : should the job be retried later (true) or is it done (false)
+	typedef map<int, bool> FailedJobPolicy;
+
+	enum JobOutcome{
+		JOB_SUCCEEDED,
+		JOB_FAILED_WILL_RETRY, //job stays in the failed dir, will be retried later
+		JOB_FAILED_DROPPED, //job failed too many times, it was deleted
+		JOB_EXPIRED //job reached its expiryTime before it could be sent, it was deleted
+	};
+
+	struct JobExecutionResult{
+		bool ok = false;
+		JobOutcome outcome = JOB_FAILED_WILL_RETRY;
+		bool isJobFresh = true; //ie not a retry, the first time we try
+		int numTries = 0; //how many times this job had failed before this attempt
+		double time = 0; //when the job finished executing (getClock() time)
+		float timeOut = 0; //the (total) time out used for this attempt - seconds, 0 if never attempted (ie expired)
+		float duration = 0; //how long the attempt took - seconds
+		string jobID;
+		string serverResponse;
+		string errorDescription;
+		int serverStatusCode = -1;
+	};
+
+	static string getNewUUID(); //random (v4) UUID
+	static string getNewULID(); //26 chars, lexically sortable by creation time, monotonic within the process
+	static string getULID(uint64_t unixTimeMs, const string & seed); //same args, same ULID - ie for jobs saved by older versions
+	static string getFileSystemSafeString(const string & input);
+	static string getUniqueFilename(const string & name); //"unique" filename generator
+
+	static FailedJobPolicy getDefaultRetryPolicy();
+};
@@ -4,150 +4,33 @@
 //
 //  Created by Oriol Ferrer Mesià on 01/02/15.
 //
+//  openFrameworks front end for the upload engine in src/core (ofxUserContentUploadCore):
+//  uploads through ofxHttpForm by default, logs through ofLog, resolves relative paths
+//  against the data folder and delivers results as an ofEvent from update().
 //
 
 #pragma once
 
 #include "ofMain.h"
 #include "HttpFormManager.h"
+#include "ofxUserContentUploadCore.h"
 
-#define PENDING_JOBS_LOCAL_PATH					(storageDir + "/pending")
-#define FAILED_PENDING_JOBS_LOCAL_PATH			(storageDir + "/failed")
 
-
-class ofxUserContentUpload: public ofThread{
+class ofxUserContentUpload: public ofxUserContentUploadCore{
 
 public:
 
-	struct Job{
-
-		void createJob(const string & host, int port, string jobID = ""){
-			this->host = host;
-			this->port = port;
-			this->jobID = jobID;
-		}
-
-		void addFile(const string & fileName, const string & filePath, string mimeType = "text/plain"){
-			if(fileFields.find(fileName) == fileFields.end()){
-				fileFields[fileName] = std::make_pair(filePath, mimeType);
-			}else{
-				ofLogError("ofxUserContentUpload::Job") << "cant addFile(), already exists! " << fileName;
-			}
-		}
-
-		void addStringField(const string & filedName, const string & fieldValue){
-			if(formFields.find(filedName) == formFields.end()){
-				formFields[filedName] = fieldValue;
-			}else{
-				ofLogError("ofxUserContentUpload::Job") << "cant addStringField(), already exists! " << filedName;
-			}
-		}
-
-		string host;
-		int port;
-		string jobID; //you will get this ID back when the job is done
-
-		map<string, string>						formFields; //fieldName-value
-		map<string, std::pair<string, string>>	fileFields; //filedName : <filepath, mimetype> (ie "text/plain")
-
-		int timeStamp;
-		bool verbose;
-		int numTries = 0;
-
-		Job(){
-			timeStamp = ofGetUnixTime();
-		}
+	//ofxHttpForm's HttpFormManager - HTTP/1.1, one connection per job.
+	//HttpFormManager only has one time out for the whole job, so connectTimeOut is ignored.
+	struct HttpFormTransport : public Transport{
+		TransportResponse submitJob(const Job & job, float connectTimeOut, float timeOut);
 	};
 
-	typedef map<HTTPResponse::HTTPStatus, bool>	 FailedJobPolicy;
-
-	struct JobExecutionResult{
-		bool ok;
-		bool isJobFresh; //ie not a retry, the first time we try
-		string jobID;
-		string serverResponse;
-		string errorDescription;
-		HTTPResponse::HTTPStatus serverStatusCode;
-	};
-
-	ofxUserContentUpload();
+	ofxUserContentUpload(); //sets HttpFormTransport as the transport
 	virtual ~ofxUserContentUpload();
 
-	void setup(const string & storageDir, FailedJobPolicy retryPolicy = getDefaultRetryPolicy());
-
-	void addJob(Job & job);
-
-	void update();
+	void update(); //call from your app's update() to get eventJobExecuted
 	void draw(int x, int y);
 
-	void setMaxNumberRetries(int n){ maxJobRetries = n;} //if a job failed to send (and keeps failing)it will only be re-tried N times at max
-	int& getMaxNumRetries(){return maxJobRetries;} //all files will be deleted for that job
-	void setTimeOut(float timeOut_){timeOut = timeOut_;}
-	float& getTimeOut(){return timeOut;}
-	float& getExecuteJobsRate(){return executeJobsRate;} //seconds - look if there's jobs pending every N seconds
-	int& getFailJobSkipRetryFactor(){return failJobSkipRetryFactor;}
-
 	ofEvent<JobExecutionResult> eventJobExecuted;
-
-	static string getNewUUID();
-	static string getFileSystemSafeString(const string & input);
-	static string getUniqueFilename(const string & name); //"unique" filename generator
-
-	static FailedJobPolicy getDefaultRetryPolicy();
-
-private:
-
-	FailedJobPolicy retryPolicy;
-
-	vector<Job> pendingApiRequests;
-
-	void threadedFunction();
-	bool threadRuns = false;
-
-	void saveJobToDisk(const Job &, bool failedDir);
-	bool loadJobFromDisk(const string & path, Job & job);
-	bool executeNextPendingJob(bool fromFailedFolder);
-	bool executeJob(const Job &,
-					string & serverResponse,
-					HTTPResponse::HTTPStatus & serverStatus,
-					string & errorDescription
-					);
-
-	void printStatus(const string & jobID,
-					 HttpFormResponse & r,
-					 const string & serverMsg,
-					 HTTPResponse::HTTPStatus status);
-
-	string fileNameForJob(const Job &, bool failedDir);
-	string	apiToken;
-	float timeOut;
-
-	vector<JobExecutionResult> executedJobs;
-
-	float executeJobsRate; //seconds
-	int failJobSkipRetryFactor; //N times executeJobsRate
-
-	int numExecutedOkJobs = 0;
-	int numExecutedFailedJobs = 0;
-
-	int maxJobRetries = 50;
-
-	string storageDir;
-
-	int numPendingWhenLastChecked = 0;
-	int numFailedWhenLastChecked = 0;
-
-	bool shouldRetryJobLater(HTTPResponse::HTTPStatus); //this decides if a job is to give up or retry later if it failed
-	HTTPResponse::HTTPStatus analyzeStatus(HttpFormResponse & r, string &serverMessage, bool verbose);
-
-	void deleteFilesForJob(const Job & job);
-#ifdef TARGET_WIN32
-	const string separator1 = "$$$$$$$$$$$$$$$$$$$  ";
-	const string separator2 = "  $$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$";
-#else
-	const string separator1 = "░░░░░░░░░░░░░░░░░░░  ";
-	const string separator2 = " ░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░";
-
-#endif
 };
-